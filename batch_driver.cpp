@@ -32,34 +32,42 @@
 #include "cyberiadasm_render.h"
 
 int runBatchMode(CyberiadaSMEditorApplication& app, const QString& fileName, bool dump,
-				 const QString& script, const QString& save, const QString& exportImage)
+				 const QString& script, const QString& save, const QString& exportImage,
+				 CyberiadaSMCacheMode cache, bool repaint)
 {
 	CyberiadaSMEditorWindow win;
 	win.show();
 
 	QString error;
-	if (!win.openDocument(fileName, &error)) {
+	if (!win.openDocument(fileName, &error, cache)) {
 		fprintf(stderr, "cannot load %s\n%s\n", qPrintable(fileName), qPrintable(error));
 		return batchLoadError;
 	}
 
+	QList<QRectF> repainted;
 	if (!script.isEmpty()) {
-		// batch edits address the model only; the live model->scene sync is
-		// re-entrant (syncFromModel writes geometry back into the model and
-		// crashes on reparent) - detach it, the scene is rebuilt below
-		QObject::disconnect(win.getModel(), NULL, win.getScene(), NULL);
+		if (repaint) {
+			// the loaded scene is painted first, only the edits are recorded;
+			// a connected changed() makes the scene report every item update
+			app.processEvents();
+			QObject::connect(win.getScene(), &QGraphicsScene::changed,
+							 [&repainted](const QList<QRectF>& rects) { repainted += rects; });
+		}
+		// batch edits address the model only, the scene follows every change
 		if (!runEditScript(win.getModel(), script, &error)) {
 			fprintf(stderr, "script %s failed\n%s\n", qPrintable(script), qPrintable(error));
 			return batchScriptError;
 		}
-		// the scene does not track model insertions/removals - rebuild it
-		if (win.getModel()->firstSMIndex().isValid()) {
-			win.getScene()->loadScene();
-		}
+		// the item syncs queued by the script land before the dump
+		win.getScene()->slotFlushSync();
 	}
 
 	// let the loaded scene settle; assertions here are caught by notify()
 	app.processEvents();
+	if (repaint) {
+		// the dirty items are collected first, changed() is emitted after them
+		app.processEvents();
+	}
 	if (app.errorReported()) {
 		return batchInternalError;
 	}
@@ -71,6 +79,11 @@ int runBatchMode(CyberiadaSMEditorApplication& app, const QString& fileName, boo
 		dumpScene(win.getScene(), win.getModel(), std::cout);
 	}
 
+	if (repaint) {
+		std::cout << "== repaint" << std::endl;
+		dumpRepaint(win.getScene(), win.getModel(), repainted, std::cout);
+	}
+
 	if (!exportImage.isEmpty()) {
 		QString render_error;
 		if (!renderScene(win.getScene(), exportImage, &render_error)) {
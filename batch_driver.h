@@ -26,6 +26,8 @@
 
 #include <QString>
 
+#include "cyberiadasm_document_cache.h"
+
 class CyberiadaSMEditorApplication;
 
 // exit codes of the batch mode (see docs/TESTING.md)
@@ -40,6 +42,7 @@ enum BatchExitCode {
 
 int runBatchMode(CyberiadaSMEditorApplication& app, const QString& fileName, bool dump = false,
 				 const QString& script = QString(), const QString& save = QString(),
-				 const QString& exportImage = QString());
+				 const QString& exportImage = QString(), CyberiadaSMCacheMode cache = cacheDisabled,
+				 bool repaint = false);
 
 #endif
@@ -90,6 +90,12 @@ static bool runCommand(CyberiadaSMModel* model, const QStringList& tokens, QStri
 		if (!target) { *error = "unknown target id '" + tokens.at(3) + "'"; return false; }
 		Cyberiada::Action action(restOfLine(tokens, 4).toStdString());
 		return model->newTransition(sm, Cyberiada::transitionExternal, source, target, action) != NULL;
+	} else if (cmd == "undo") {
+		if (!model->undo()) { *error = "nothing to undo"; return false; }
+		return true;
+	} else if (cmd == "redo") {
+		if (!model->redo()) { *error = "nothing to redo"; return false; }
+		return true;
 	}
 
 	// the remaining commands address an existing element by id
@@ -130,6 +136,28 @@ static bool runCommand(CyberiadaSMModel* model, const QStringList& tokens, QStri
 	return false;
 }
 
+// a drag: the commands of a frame share one transaction, as the mouse moves
+// the editor scene dispatches do, and the frames are undone as one step
+static bool runDragCommand(CyberiadaSMModel* model, const QString& cmd, bool* dragging, QString* error)
+{
+	if (cmd == "drag-begin") {
+		if (*dragging) { *error = "drag-begin inside a drag"; return false; }
+		model->beginContinuousEdit();
+		model->beginTransaction();
+		*dragging = true;
+		return true;
+	}
+	if (!*dragging) { *error = cmd + " outside a drag"; return false; }
+	model->commitTransaction();
+	if (cmd == "frame") {
+		model->beginTransaction();
+	} else {
+		model->endContinuousEdit();
+		*dragging = false;
+	}
+	return true;
+}
+
 bool runEditScript(CyberiadaSMModel* model, const QString& path, QString* error)
 {
 	QFile file(path);
@@ -139,6 +167,8 @@ bool runEditScript(CyberiadaSMModel* model, const QString& path, QString* error)
 	}
 	QTextStream in(&file);
 	int lineno = 0;
+	bool dragging = false;
+	QString unused;
 	while (!in.atEnd()) {
 		QString line = in.readLine();
 		lineno++;
@@ -147,18 +177,44 @@ bool runEditScript(CyberiadaSMModel* model, const QString& path, QString* error)
 		QStringList tokens = trimmed.split(QRegularExpression("\\s+"));
 		QString message;
 		bool ok = false;
+		// every command is a separate undo step with coalesced notifications;
+		// undo & redo cannot run inside a transaction
+		const QString& cmd = tokens.first();
+		bool history_command = cmd == "undo" || cmd == "redo";
+		bool drag_command = cmd == "drag-begin" || cmd == "frame" || cmd == "drag-end";
+		bool own_transaction = !history_command && !drag_command && !dragging;
+		if (own_transaction) {
+			model->beginTransaction();
+		}
 		try {
-			ok = runCommand(model, tokens, &message);
+			if (drag_command) {
+				ok = runDragCommand(model, cmd, &dragging, &message);
+			} else if (history_command && dragging) {
+				message = cmd + " inside a drag";
+			} else {
+				ok = runCommand(model, tokens, &message);
+			}
 			if (!ok && message.isEmpty()) {
 				message = "command failed";
 			}
 		} catch (const Cyberiada::Exception& e) {
 			message = QString(e.str().c_str());
 		}
+		if (own_transaction) {
+			model->commitTransaction();
+		}
 		if (!ok) {
+			if (dragging) {
+				runDragCommand(model, "drag-end", &dragging, &unused);
+			}
 			*error = QString("line %1: %2").arg(lineno).arg(message);
 			return false;
 		}
 	}
+	if (dragging) {
+		runDragCommand(model, "drag-end", &dragging, &unused);
+		*error = QString("line %1: drag-begin without drag-end").arg(lineno);
+		return false;
+	}
 	return true;
 }
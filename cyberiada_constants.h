@@ -30,6 +30,14 @@
 #define ROUNDED_RECT_RADIUS 10
 #define VERTEX_POINT_RADIUS 10
 #define COMMENT_ANGLE_CORNER 10
+#define GRID_MIN_SPACING_PIXELS 4  // the denser grid lines are thinned out
+
+// Level of detail constants: the view scale below which the detail is dropped
+#define LOD_TEXT_THRESHOLD  0.4   // the text items are not painted
+#define LOD_SHAPE_THRESHOLD 0.2   // plain state rects, transitions without arrowheads
+
+// Interaction constants
+#define DRAG_FRAME_INTERVAL_MS 16 // the buffered drag moves are applied once per frame
 
 // Metainformation constants
 #define METAINFORMATION_AUTHOR            "Author"
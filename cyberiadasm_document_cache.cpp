@@ -0,0 +1,560 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ *
+ * The binary sidecar cache of the State Machine Documents implementation
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QObject>
+#include <QHash>
+
+#include "cyberiadasm_document_cache.h"
+
+// "CYBC"
+#define CACHE_MAGIC   0x43594243
+#define CACHE_VERSION 2
+
+/* -----------------------------------------------------------------------------
+ * The cache file layout (QDataStream):
+ *   magic, version,
+ *   document size, mtime (ms), SHA-1 of the document content,
+ *   document format, geometry format,
+ *   SHA-1 of the payload, payload
+ * The payload is the document meta followed by the element tree in the
+ * document order; the element IDs are stored and restored as is.
+ * ----------------------------------------------------------------------------- */
+
+QString documentCachePath(const QString& path)
+{
+	return path + DOCUMENT_CACHE_SUFFIX;
+}
+
+static QByteArray fileHash(const QString& path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QByteArray();
+	}
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	if (!hash.addData(&file)) {
+		return QByteArray();
+	}
+	return hash.result();
+}
+
+static void setError(QString* error, const QString& message)
+{
+	if (error) {
+		*error = message;
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Writing
+ * ----------------------------------------------------------------------------- */
+
+static QDataStream& operator<<(QDataStream& s, const Cyberiada::String& str)
+{
+	return s << QByteArray(str.data(), int(str.size()));
+}
+
+static QDataStream& operator<<(QDataStream& s, const Cyberiada::Point& p)
+{
+	return s << double(p.x) << double(p.y);
+}
+
+static QDataStream& operator<<(QDataStream& s, const Cyberiada::Rect& r)
+{
+	return s << double(r.x) << double(r.y) << double(r.width) << double(r.height);
+}
+
+static QDataStream& operator<<(QDataStream& s, const Cyberiada::Action& a)
+{
+	return s << qint32(a.get_type()) << a.get_trigger() << a.get_guard() << a.get_behavior();
+}
+
+static QDataStream& operator<<(QDataStream& s, const Cyberiada::Polyline& pl)
+{
+	s << quint32(pl.size());
+	for (Cyberiada::Polyline::const_iterator i = pl.begin(); i != pl.end(); i++) {
+		s << *i;
+	}
+	return s;
+}
+
+static bool writeElement(QDataStream& s, const Cyberiada::Element* element)
+{
+	Cyberiada::ElementType type = element->get_type();
+	s << qint32(type) << element->get_id() << element->get_name();
+	switch (type) {
+	case Cyberiada::elementSM:
+	case Cyberiada::elementSimpleState:
+	case Cyberiada::elementCompositeState: {
+		const Cyberiada::ElementCollection* collection = static_cast<const Cyberiada::ElementCollection*>(element);
+		s << collection->has_geometry() << collection->get_geometry_rect() << collection->get_color();
+		if (type != Cyberiada::elementSM) {
+			const Cyberiada::State* state = static_cast<const Cyberiada::State*>(element);
+			const std::vector<Cyberiada::Action>& actions = state->get_actions();
+			s << quint32(actions.size());
+			for (std::vector<Cyberiada::Action>::const_iterator i = actions.begin(); i != actions.end(); i++) {
+				s << *i;
+			}
+			s << state->has_region_geometry() << state->get_region_geometry_rect();
+		}
+		const Cyberiada::ElementList& children = collection->get_children();
+		s << quint32(children.size());
+		// the transitions are restored after all the vertices they connect, so
+		// they must already follow the other children
+		bool transitions = false;
+		for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+			if ((*i)->get_type() == Cyberiada::elementTransition) {
+				transitions = true;
+			} else if (transitions) {
+				return false;
+			}
+			if (!writeElement(s, *i)) {
+				return false;
+			}
+		}
+		break;
+	}
+	case Cyberiada::elementInitial:
+	case Cyberiada::elementFinal:
+	case Cyberiada::elementTerminate: {
+		const Cyberiada::Vertex* vertex = static_cast<const Cyberiada::Vertex*>(element);
+		s << vertex->has_geometry() << vertex->get_geometry_point();
+		break;
+	}
+	case Cyberiada::elementChoice: {
+		const Cyberiada::ChoicePseudostate* choice = static_cast<const Cyberiada::ChoicePseudostate*>(element);
+		s << choice->has_geometry() << choice->get_geometry_rect() << choice->get_color();
+		break;
+	}
+	case Cyberiada::elementComment:
+	case Cyberiada::elementFormalComment: {
+		const Cyberiada::Comment* comment = static_cast<const Cyberiada::Comment*>(element);
+		if (comment->has_subjects()) {
+			// the subject geometry cannot be restored through the public API
+			return false;
+		}
+		s << comment->get_body() << comment->has_geometry() << comment->get_geometry_rect()
+		  << comment->get_color() << comment->get_markup();
+		break;
+	}
+	case Cyberiada::elementTransition: {
+		const Cyberiada::Transition* trans = static_cast<const Cyberiada::Transition*>(element);
+		s << qint32(trans->get_transition_type())
+		  << trans->source_element_id() << trans->target_element_id()
+		  << trans->get_action()
+		  << trans->has_polyline() << trans->get_geometry_polyline()
+		  << trans->has_geometry_source_point() << trans->get_source_point()
+		  << trans->has_geometry_target_point() << trans->get_target_point()
+		  << trans->has_geometry_label_point() << trans->get_label_point()
+		  << trans->get_color();
+		break;
+	}
+	default:
+		return false;
+	}
+	return s.status() == QDataStream::Ok;
+}
+
+static bool writeDocument(QDataStream& s, const Cyberiada::LocalDocument* doc)
+{
+	const Cyberiada::DocumentMetainformation& meta = doc->meta();
+	s << meta.standard_version << quint32(meta.strings.size());
+	for (std::vector<std::pair<Cyberiada::String, Cyberiada::String> >::const_iterator i = meta.strings.begin();
+		 i != meta.strings.end(); i++) {
+		s << i->first << i->second;
+	}
+	s << meta.transition_order_flag << meta.event_propagation_flag;
+
+	// the meta element is regenerated from the meta information
+	const Cyberiada::Element* meta_element = doc->get_meta_element();
+	const Cyberiada::ElementList& children = doc->get_children();
+	quint32 count = 0;
+	for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+		if (*i != meta_element) count++;
+	}
+	s << count;
+	for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+		if (*i == meta_element) continue;
+		if ((*i)->get_type() != Cyberiada::elementSM || !writeElement(s, *i)) {
+			return false;
+		}
+	}
+	return s.status() == QDataStream::Ok;
+}
+
+bool writeDocumentCache(const QString& path, const Cyberiada::LocalDocument* doc, Cyberiada::DocumentGeometryFormat gf,
+						QString* error)
+{
+	if (!doc || doc->get_file_format() != Cyberiada::formatCyberiada10) {
+		// the other formats are converted on load and saved back differently
+		setError(error, QObject::tr("Only CyberiadaML-1.0 documents are cached"));
+		return false;
+	}
+
+	QByteArray payload;
+	{
+		QDataStream s(&payload, QIODevice::WriteOnly);
+		s.setVersion(QDataStream::Qt_5_0);
+		if (!writeDocument(s, doc)) {
+			setError(error, QObject::tr("The document content cannot be cached"));
+			return false;
+		}
+	}
+
+	QFileInfo info(path);
+	QByteArray hash = fileHash(path);
+	if (hash.isEmpty()) {
+		setError(error, QObject::tr("Cannot read the document %1").arg(path));
+		return false;
+	}
+
+	QSaveFile file(documentCachePath(path));
+	if (!file.open(QIODevice::WriteOnly)) {
+		setError(error, file.errorString());
+		return false;
+	}
+	QDataStream s(&file);
+	s.setVersion(QDataStream::Qt_5_0);
+	s << quint32(CACHE_MAGIC) << quint32(CACHE_VERSION)
+	  << qint64(info.size()) << qint64(info.lastModified().toMSecsSinceEpoch()) << hash
+	  << qint32(doc->get_file_format()) << qint32(gf)
+	  << QCryptographicHash::hash(payload, QCryptographicHash::Sha1) << payload;
+	if (s.status() != QDataStream::Ok || !file.commit()) {
+		setError(error, file.errorString());
+		return false;
+	}
+	return true;
+}
+
+/* -----------------------------------------------------------------------------
+ * Reading
+ * ----------------------------------------------------------------------------- */
+
+class CacheFormatError {};
+
+class CacheReader {
+public:
+	CacheReader(QDataStream& stream, Cyberiada::LocalDocument* document): s(stream), doc(document) {}
+
+	void                                readDocument();
+
+private:
+	void                                check();
+	Cyberiada::String                   readString();
+	Cyberiada::Point                    readPoint();
+	Cyberiada::Rect                     readRect();
+	Cyberiada::Action                   readAction();
+	Cyberiada::Polyline                 readPolyline();
+	bool                                readBool();
+	quint32                             readCount();
+	void                                readElement(Cyberiada::ElementCollection* parent);
+
+	QDataStream&                        s;
+	Cyberiada::LocalDocument*           doc;
+	// the transition ends are looked up among the vertices restored so far
+	QHash<QString, Cyberiada::Element*> elements;
+};
+
+void CacheReader::check()
+{
+	if (s.status() != QDataStream::Ok) {
+		throw CacheFormatError();
+	}
+}
+
+Cyberiada::String CacheReader::readString()
+{
+	QByteArray b;
+	s >> b;
+	check();
+	return Cyberiada::String(b.constData(), size_t(b.size()));
+}
+
+Cyberiada::Point CacheReader::readPoint()
+{
+	double x, y;
+	s >> x >> y;
+	check();
+	return Cyberiada::Point(x, y);
+}
+
+Cyberiada::Rect CacheReader::readRect()
+{
+	double x, y, w, h;
+	s >> x >> y >> w >> h;
+	check();
+	return Cyberiada::Rect(x, y, w, h);
+}
+
+Cyberiada::Action CacheReader::readAction()
+{
+	qint32 type;
+	s >> type;
+	check();
+	Cyberiada::String trigger = readString();
+	Cyberiada::String guard = readString();
+	Cyberiada::String behavior = readString();
+	if (type == Cyberiada::actionTransition) {
+		return Cyberiada::Action(trigger, guard, behavior);
+	}
+	return Cyberiada::Action(Cyberiada::ActionType(type), behavior);
+}
+
+Cyberiada::Polyline CacheReader::readPolyline()
+{
+	Cyberiada::Polyline pl;
+	quint32 n = readCount();
+	for (quint32 i = 0; i < n; i++) {
+		pl.push_back(readPoint());
+	}
+	return pl;
+}
+
+bool CacheReader::readBool()
+{
+	bool b;
+	s >> b;
+	check();
+	return b;
+}
+
+quint32 CacheReader::readCount()
+{
+	quint32 n;
+	s >> n;
+	check();
+	// a corrupt counter must not make us loop over garbage
+	if (n > quint32(s.device()->bytesAvailable())) {
+		throw CacheFormatError();
+	}
+	return n;
+}
+
+void CacheReader::readElement(Cyberiada::ElementCollection* parent)
+{
+	qint32 type;
+	s >> type;
+	check();
+	Cyberiada::ID id = readString();
+	Cyberiada::String name = readString();
+	Cyberiada::Element* element = NULL;
+
+	switch (type) {
+	case Cyberiada::elementSM:
+	case Cyberiada::elementSimpleState:
+	case Cyberiada::elementCompositeState: {
+		bool has_rect = readBool();
+		Cyberiada::Rect r = readRect();
+		Cyberiada::Color color = readString();
+		Cyberiada::ElementCollection* collection;
+		if (type == Cyberiada::elementSM) {
+			if (parent != doc) throw CacheFormatError();
+			collection = doc->new_state_machine(name, has_rect ? r : Cyberiada::Rect());
+		} else {
+			if (parent == doc) throw CacheFormatError();
+			std::vector<Cyberiada::Action> actions;
+			quint32 n = readCount();
+			for (quint32 i = 0; i < n; i++) {
+				actions.push_back(readAction());
+			}
+			bool has_region = readBool();
+			Cyberiada::Rect region = readRect();
+			Cyberiada::State* state = doc->new_state(parent, name, Cyberiada::Action(), has_rect ? r : Cyberiada::Rect(),
+													 has_region ? region : Cyberiada::Rect(), color);
+			state->get_actions() = actions;
+			collection = state;
+		}
+		collection->set_id(id);
+		elements.insert(QString(id.c_str()), collection);
+		quint32 n = readCount();
+		for (quint32 i = 0; i < n; i++) {
+			readElement(collection);
+		}
+		return;
+	}
+	case Cyberiada::elementInitial:
+	case Cyberiada::elementFinal:
+	case Cyberiada::elementTerminate: {
+		bool has_point = readBool();
+		Cyberiada::Point p = readPoint();
+		if (!has_point) {
+			p = Cyberiada::Point();
+		}
+		if (type == Cyberiada::elementInitial) {
+			element = doc->new_initial(parent, p);
+		} else if (type == Cyberiada::elementFinal) {
+			element = doc->new_final(parent, p);
+		} else {
+			element = doc->new_terminate(parent, p);
+		}
+		break;
+	}
+	case Cyberiada::elementChoice: {
+		bool has_rect = readBool();
+		Cyberiada::Rect r = readRect();
+		Cyberiada::Color color = readString();
+		element = doc->new_choice(parent, has_rect ? r : Cyberiada::Rect(), color);
+		break;
+	}
+	case Cyberiada::elementComment:
+	case Cyberiada::elementFormalComment: {
+		Cyberiada::String body = readString();
+		bool has_rect = readBool();
+		Cyberiada::Rect r = readRect();
+		Cyberiada::Color color = readString();
+		Cyberiada::String markup = readString();
+		if (type == Cyberiada::elementComment) {
+			element = doc->new_comment(parent, body, has_rect ? r : Cyberiada::Rect(), color, markup);
+		} else {
+			element = doc->new_formal_comment(parent, body, has_rect ? r : Cyberiada::Rect(), color, markup);
+		}
+		element->set_name(name);
+		break;
+	}
+	case Cyberiada::elementTransition: {
+		if (parent->get_type() != Cyberiada::elementSM) throw CacheFormatError();
+		qint32 ttype;
+		s >> ttype;
+		check();
+		Cyberiada::ID source_id = readString();
+		Cyberiada::ID target_id = readString();
+		Cyberiada::Action action = readAction();
+		bool has_pl = readBool();
+		Cyberiada::Polyline pl = readPolyline();
+		bool has_sp = readBool();
+		Cyberiada::Point sp = readPoint();
+		bool has_tp = readBool();
+		Cyberiada::Point tp = readPoint();
+		bool has_lp = readBool();
+		Cyberiada::Point lp = readPoint();
+		Cyberiada::Color color = readString();
+		Cyberiada::Element* source = elements.value(QString(source_id.c_str()), NULL);
+		Cyberiada::Element* target = elements.value(QString(target_id.c_str()), NULL);
+		if (!source || !target) throw CacheFormatError();
+		element = doc->new_transition(static_cast<Cyberiada::StateMachine*>(parent), Cyberiada::TransitionType(ttype),
+									  source, target, action,
+									  has_pl ? pl : Cyberiada::Polyline(),
+									  has_sp ? sp : Cyberiada::Point(),
+									  has_tp ? tp : Cyberiada::Point(),
+									  has_lp ? lp : Cyberiada::Point(),
+									  Cyberiada::Rect(), color);
+		break;
+	}
+	default:
+		throw CacheFormatError();
+	}
+	element->set_id(id);
+	elements.insert(QString(id.c_str()), element);
+}
+
+void CacheReader::readDocument()
+{
+	Cyberiada::DocumentMetainformation& meta = const_cast<Cyberiada::DocumentMetainformation&>(
+		static_cast<const Cyberiada::LocalDocument*>(doc)->meta());
+	meta.standard_version = readString();
+	meta.strings.clear();
+	quint32 n = readCount();
+	for (quint32 i = 0; i < n; i++) {
+		Cyberiada::String key = readString();
+		Cyberiada::String value = readString();
+		meta.strings.push_back(std::make_pair(key, value));
+	}
+	meta.transition_order_flag = readBool();
+	meta.event_propagation_flag = readBool();
+
+	n = readCount();
+	for (quint32 i = 0; i < n; i++) {
+		readElement(doc);
+	}
+	if (!s.atEnd()) {
+		throw CacheFormatError();
+	}
+}
+
+Cyberiada::LocalDocument* readDocumentCache(const QString& path, Cyberiada::DocumentGeometryFormat gf,
+											QString* error)
+{
+	QFile file(documentCachePath(path));
+	if (!file.open(QIODevice::ReadOnly)) {
+		setError(error, QObject::tr("No cache"));
+		return NULL;
+	}
+	QDataStream s(&file);
+	s.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic, version;
+	qint64 size, mtime;
+	qint32 format, geometry_format;
+	QByteArray hash, payload_hash, payload;
+	s >> magic >> version;
+	if (s.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION) {
+		setError(error, QObject::tr("Unknown cache format"));
+		return NULL;
+	}
+	s >> size >> mtime >> hash;
+	QFileInfo info(path);
+	// the size & mtime check is cheap, the content hash catches the rest
+	if (s.status() != QDataStream::Ok ||
+		size != info.size() || mtime != info.lastModified().toMSecsSinceEpoch() ||
+		hash != fileHash(path)) {
+		setError(error, QObject::tr("Stale cache"));
+		return NULL;
+	}
+	s >> format >> geometry_format;
+	// the model saves a restored document as CyberiadaML-1.0 and the element
+	// geometry is restored as is, in the format it was cached with
+	if (s.status() != QDataStream::Ok ||
+		format != Cyberiada::formatCyberiada10 || geometry_format != qint32(gf)) {
+		setError(error, QObject::tr("Stale cache"));
+		return NULL;
+	}
+	s >> payload_hash >> payload;
+	if (s.status() != QDataStream::Ok ||
+		payload_hash != QCryptographicHash::hash(payload, QCryptographicHash::Sha1)) {
+		setError(error, QObject::tr("Corrupt cache"));
+		return NULL;
+	}
+
+	QDataStream ps(payload);
+	ps.setVersion(QDataStream::Qt_5_0);
+	Cyberiada::LocalDocument* doc = new Cyberiada::LocalDocument();
+	try {
+		CacheReader reader(ps, doc);
+		reader.readDocument();
+	} catch (const CacheFormatError&) {
+		setError(error, QObject::tr("Corrupt cache"));
+		delete doc;
+		return NULL;
+	} catch (const Cyberiada::Exception& e) {
+		setError(error, QObject::tr("Corrupt cache: %1").arg(e.str().c_str()));
+		delete doc;
+		return NULL;
+	}
+	return doc;
+}
@@ -0,0 +1,54 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ *
+ * The binary sidecar cache of the State Machine Documents
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef CYBERIADA_SM_DOCUMENT_CACHE_HEADER
+#define CYBERIADA_SM_DOCUMENT_CACHE_HEADER
+
+#include <QString>
+#include <cyberiada/cyberiadamlpp.h>
+
+#define DOCUMENT_CACHE_SUFFIX ".cybcache"
+
+enum CyberiadaSMCacheMode {
+	cacheDisabled,       // parse the XML, do not touch the cache file
+	cacheEnabled,        // use a valid cache, otherwise parse the XML and write the cache
+	cacheRefresh         // parse the XML and rewrite the cache
+};
+
+// the sidecar cache file of the document (file.graphml.cybcache)
+QString documentCachePath(const QString& path);
+
+// rebuild the document from the cache; returns NULL when the cache is missing,
+// stale (the document size, mtime or content hash differ, or the document was
+// cached with another geometry format) or corrupt; the restored document has
+// no file bound and is saved back as CyberiadaML-1.0, the only cached format
+Cyberiada::LocalDocument* readDocumentCache(const QString& path, Cyberiada::DocumentGeometryFormat gf,
+											QString* error = NULL);
+
+// write the cache of the document just loaded from the path with the geometry
+// format; documents with the content the cache cannot represent are not
+// cached (returns false)
+bool writeDocumentCache(const QString& path, const Cyberiada::LocalDocument* doc, Cyberiada::DocumentGeometryFormat gf,
+						QString* error = NULL);
+
+#endif
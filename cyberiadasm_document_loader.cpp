@@ -0,0 +1,79 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ *
+ * The State Machine Document background loader implementation
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#include "cyberiadasm_document_loader.h"
+#include "cyberiadasm_model.h"
+
+CyberiadaSMDocumentLoader::CyberiadaSMDocumentLoader(const QString& path, bool reconstruct, bool reconstruct_sm,
+													 CyberiadaSMCacheMode cache, QObject* parent):
+	QThread(parent), filePath(path), reconstructDoc(reconstruct), reconstructSM(reconstruct_sm),
+	cacheMode(cache), cancelled(0), document(NULL)
+{
+}
+
+CyberiadaSMDocumentLoader::~CyberiadaSMDocumentLoader()
+{
+	cancel();
+	wait();
+	if (document) {
+		delete document;
+	}
+}
+
+Cyberiada::LocalDocument* CyberiadaSMDocumentLoader::takeDocument()
+{
+	// the signals may arrive just before run() returns
+	wait();
+	if (isCancelled()) {
+		return NULL;
+	}
+	Cyberiada::LocalDocument* result = document;
+	document = NULL;
+	return result;
+}
+
+void CyberiadaSMDocumentLoader::cancel()
+{
+	cancelled.storeRelease(1);
+}
+
+void CyberiadaSMDocumentLoader::run()
+{
+	QString error;
+	Cyberiada::LocalDocument* new_doc = CyberiadaSMModel::parseDocument(filePath, reconstructDoc, reconstructSM, error,
+																			  cacheMode);
+	if (isCancelled()) {
+		if (new_doc) {
+			delete new_doc;
+		}
+		return;
+	}
+	// the signals are queued to the GUI thread, the fields are read after wait()
+	document = new_doc;
+	lastLoadError = error;
+	if (document) {
+		emit documentLoaded(filePath);
+	} else {
+		emit loadFailed(filePath, lastLoadError);
+	}
+}
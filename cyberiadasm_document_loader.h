@@ -0,0 +1,71 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ *
+ * The State Machine Document background loader
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef CYBERIADA_SM_DOCUMENT_LOADER_HEADER
+#define CYBERIADA_SM_DOCUMENT_LOADER_HEADER
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QString>
+#include <cyberiada/cyberiadamlpp.h>
+
+#include "cyberiadasm_document_cache.h"
+
+// Parses a document on a worker thread; the parsed document is handed to
+// the model on the GUI thread with CyberiadaSMModel::setDocument()
+class CyberiadaSMDocumentLoader: public QThread {
+Q_OBJECT
+
+public:
+	CyberiadaSMDocumentLoader(const QString& path, bool reconstruct = false, bool reconstruct_sm = false,
+							  CyberiadaSMCacheMode cache = cacheDisabled, QObject* parent = NULL);
+	~CyberiadaSMDocumentLoader();
+
+	const QString&                      path() const { return filePath; }
+	const QString&                      loadError() const { return lastLoadError; }
+	bool                                isCancelled() const { return cancelled.loadAcquire() != 0; }
+	// the caller takes the ownership of the document; NULL on error or cancel
+	Cyberiada::LocalDocument*           takeDocument();
+
+public slots:
+	// the library parser cannot be interrupted, the result is dropped instead
+	void                                cancel();
+
+signals:
+	void                                documentLoaded(const QString& path);
+	void                                loadFailed(const QString& path, const QString& error);
+
+protected:
+	void                                run();
+
+private:
+	QString                             filePath;
+	bool                                reconstructDoc;
+	bool                                reconstructSM;
+	CyberiadaSMCacheMode                cacheMode;
+	QAtomicInt                          cancelled;
+	Cyberiada::LocalDocument*           document;
+	QString                             lastLoadError;
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include <string>
 
 #include <QString>
+#include <QRegion>
 
 #include "cyberiadasm_dump.h"
 #include "cyberiadasm_model.h"
@@ -56,7 +57,7 @@ static void dumpSceneElement(CyberiadaSMEditorScene* scene, Cyberiada::Element*
 							 int depth, std::ostream& os)
 {
 	Cyberiada::ID id = element->get_id();
-	QGraphicsItem* item = scene->getMap().value(id, NULL);
+	QGraphicsItem* item = scene->getRegistry().item(id);
 	if (item && element->get_type() != Cyberiada::elementRoot) {
 		QPointF p = item->pos();
 		QRectF r = item->boundingRect();
@@ -87,3 +88,34 @@ void dumpScene(CyberiadaSMEditorScene* scene, CyberiadaSMModel* model, std::ostr
 {
 	dumpSceneElement(scene, model->rootDocument(), 0, os);
 }
+
+static void dumpRepaintElement(CyberiadaSMEditorScene* scene, Cyberiada::Element* element,
+							   const QRegion& repainted, std::ostream& os)
+{
+	Cyberiada::ID id = element->get_id();
+	QGraphicsItem* item = scene->getRegistry().item(id);
+	if (item && element->get_type() != Cyberiada::elementRoot) {
+		QRect r = item->sceneBoundingRect().toAlignedRect();
+		if (!r.isEmpty() && QRegion(r).subtracted(repainted).isEmpty()) {
+			os << "  " << elementTypeName(element->get_type())
+			   << ": {id: '" << id << "'}" << std::endl;
+		}
+	}
+	Cyberiada::ElementCollection* collection = dynamic_cast<Cyberiada::ElementCollection*>(element);
+	if (collection) {
+		const Cyberiada::ElementList& children = collection->get_children();
+		for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+			dumpRepaintElement(scene, *i, repainted, os);
+		}
+	}
+}
+
+void dumpRepaint(CyberiadaSMEditorScene* scene, CyberiadaSMModel* model,
+				 const QList<QRectF>& repainted, std::ostream& os)
+{
+	QRegion region;
+	for (const QRectF& rect : repainted) {
+		region += rect.toAlignedRect();
+	}
+	dumpRepaintElement(scene, model->rootDocument(), region, os);
+}
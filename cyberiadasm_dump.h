@@ -25,6 +25,8 @@
 #define CYBERIADA_SM_DUMP
 
 #include <ostream>
+#include <QList>
+#include <QRectF>
 
 class CyberiadaSMModel;
 class CyberiadaSMEditorScene;
@@ -33,5 +35,9 @@ class CyberiadaSMEditorScene;
 void dumpDocument(CyberiadaSMModel* model, std::ostream& os);
 // the scene part lists the items in document order with fixed 2-decimal geometry
 void dumpScene(CyberiadaSMEditorScene* scene, CyberiadaSMModel* model, std::ostream& os);
+// the repaint part lists the items, in document order, whose scene bounds are
+// fully covered by the repainted scene areas
+void dumpRepaint(CyberiadaSMEditorScene* scene, CyberiadaSMModel* model,
+				 const QList<QRectF>& repainted, std::ostream& os);
 
 #endif
@@ -39,12 +39,13 @@ CyberiadaSMEditorCommentItem::CyberiadaSMEditorCommentItem(QObject *parent_objec
                                                            CyberiadaSMModel *model,
                                                            Cyberiada::Element *element,
                                                            QGraphicsItem *parent,
-                                                           QMap<Cyberiada::ID, QGraphicsItem*>& elementItem) :
+                                                           CyberiadaSMEditorItemRegistry& registry) :
     CyberiadaSMEditorAbstractItem(model, element, parent),
     // QObject(parent_object),
-    elementIdToItemMap(elementItem)
+    itemRegistry(registry)
 {
     comment = static_cast<const Cyberiada::Comment*>(element);
+    refreshGeometry();
 
     if(comment->has_geometry()){
         Cyberiada::Rect r = comment->get_geometry_rect();
@@ -94,11 +95,31 @@ QRectF CyberiadaSMEditorCommentItem::boundingRect() const
         }
         return body->boundingRect();
     }
-    Cyberiada::Rect r = comment->get_geometry_rect();
-    return QRectF(- r.width / 2,
-                  - r.height / 2,
-                  r.width,
-                  r.height);
+    return localRect;
+}
+
+void CyberiadaSMEditorCommentItem::refreshGeometry()
+{
+    if (!comment->has_geometry()) return;
+    Cyberiada::Rect g = comment->get_geometry_rect();
+    QRectF r = QRectF(- g.width / 2,
+                      - g.height / 2,
+                      g.width,
+                      g.height);
+    if (r == localRect) return;
+
+    prepareGeometryChange();
+    localRect = r;
+    outline.clear();
+    outline << QPointF(r.left(), r.top())
+            << QPointF(r.right() - COMMENT_ANGLE_CORNER, r.top())
+            << QPointF(r.right(), r.top() + COMMENT_ANGLE_CORNER)
+            << QPointF(r.right(), r.bottom())
+            << QPointF(r.left(), r.bottom());
+    corner.clear();
+    corner << QPointF(r.right() - COMMENT_ANGLE_CORNER, r.top())
+           << QPointF(r.right(), r.top() + COMMENT_ANGLE_CORNER)
+           << QPointF(r.right()- COMMENT_ANGLE_CORNER, r.top() + COMMENT_ANGLE_CORNER);
 }
 
 void CyberiadaSMEditorCommentItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
@@ -108,10 +129,10 @@ void CyberiadaSMEditorCommentItem::paint(QPainter* painter, const QStyleOptionGr
     QPen pen = QPen(Qt::black, 1, Qt::SolidLine);
     QBrush brush = commentBrush;
     if (isSelected()) {
-        SettingsManager& sm = SettingsManager::instance();
-        pen.setColor(sm.getSelectionColor());
-        pen.setWidth(sm.getSelectionBorderWidth());
-        QColor fillColor = sm.getSelectionColor();
+        const CyberiadaSMEditorStyle& st = style();
+        pen.setColor(st.selectionColor);
+        pen.setWidth(st.selectionBorderWidth);
+        QColor fillColor = st.selectionColor;
         fillColor.setAlpha(200);
         brush.setColor(fillColor);
     }
@@ -119,17 +140,7 @@ void CyberiadaSMEditorCommentItem::paint(QPainter* painter, const QStyleOptionGr
     painter->setPen(pen);
     painter->setBrush(brush);
 
-    QRectF r = boundingRect();
-
-    const QPointF points[] = {
-        QPointF(r.left(), r.top()),
-        QPointF(r.right() - COMMENT_ANGLE_CORNER, r.top()),
-        QPointF(r.right(), r.top() + COMMENT_ANGLE_CORNER),
-        QPointF(r.right(), r.bottom()),
-        QPointF(r.left(), r.bottom())
-    };
-
-    painter->drawConvexPolygon(points, 5);
+    painter->drawConvexPolygon(outline);
 
     Cyberiada::ElementType type = element->get_type();
     if (type == Cyberiada::elementFormalComment) {
@@ -138,13 +149,7 @@ void CyberiadaSMEditorCommentItem::paint(QPainter* painter, const QStyleOptionGr
         painter->setBrush(brush);
     }
 
-    const QPointF triangle[] = {
-        QPointF(r.right() - COMMENT_ANGLE_CORNER, r.top()),
-        QPointF(r.right(), r.top() + COMMENT_ANGLE_CORNER),
-        QPointF(r.right()- COMMENT_ANGLE_CORNER, r.top() + COMMENT_ANGLE_CORNER)
-    };
-
-    painter->drawConvexPolygon(triangle, 3);
+    painter->drawConvexPolygon(corner);
 }
 
 // TODO
@@ -163,6 +168,11 @@ void CyberiadaSMEditorCommentItem::setTextPosition()
 void CyberiadaSMEditorCommentItem::syncFromModel()
 {
     // TODO
+    refreshGeometry();
+    if (comment->has_geometry()) {
+        Cyberiada::Rect r = comment->get_geometry_rect();
+        setPos(QPointF(r.x, r.y));
+    }
     CyberiadaSMEditorAbstractItem::syncFromModel();
 }
 
@@ -26,8 +26,10 @@
 
 #include <QObject>
 #include <QBrush>
+#include <QPolygonF>
 
 #include "cyberiadasm_editor_items.h"
+#include "cyberiadasm_editor_registry.h"
 #include "editable_text_item.h"
 
 /* -----------------------------------------------------------------------------
@@ -43,7 +45,7 @@ public:
                          CyberiadaSMModel *model,
                          Cyberiada::Element *element,
                          QGraphicsItem *parent,
-                         QMap<Cyberiada::ID, QGraphicsItem*> &elementItem);
+                         CyberiadaSMEditorItemRegistry &registry);
     ~CyberiadaSMEditorCommentItem();
 
     virtual int type() const { return CommentItem; }
@@ -56,6 +58,7 @@ public:
 
 protected:
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+    void refreshGeometry() override;
 
 private slots:
     void onBodyChanged();
@@ -63,9 +66,13 @@ private slots:
 private:
     EditableTextItem* body;
     QBrush commentBrush;
+    // the model rect and the note outline, refreshed by syncFromModel()
+    QRectF localRect;
+    QPolygonF outline;
+    QPolygonF corner;
 
     const Cyberiada::Comment* comment;
-    QMap<Cyberiada::ID, QGraphicsItem*>& elementIdToItemMap;
+    CyberiadaSMEditorItemRegistry& itemRegistry;
 };
 
 #endif // CYBERIADASM_EDITOR_COMMENT_ITEM_H
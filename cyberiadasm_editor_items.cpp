@@ -31,6 +31,7 @@
 #include "cyberiadasm_editor_state_item.h"
 #include "settings_manager.h"
 #include "myassert.h"
+#include "cyberiadasm_editor_logging.h"
 
 
 /* -----------------------------------------------------------------------------
@@ -46,47 +47,10 @@ CyberiadaSMEditorAbstractItem::CyberiadaSMEditorAbstractItem(CyberiadaSMModel* _
     element(_element),
     cornerFlags(0)
 {
-    connect(&SettingsManager::instance(), &SettingsManager::inspectorModeChanged, this, &CyberiadaSMEditorAbstractItem::slotInspectorModeChanged);
-    connect(&SettingsManager::instance(), &SettingsManager::selectionSettingsChanged, this, &CyberiadaSMEditorAbstractItem::slotSelectionSettingsChanged);
-
     prevItemUnderCursor = nullptr;
     isHighlighted = false;
-
-    if(parent) {
-        CyberiadaSMEditorAbstractItem* newParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(parent);
-        if(newParent) {
-            prevItemUnderCursor = newParent;
-            // change in parent geometry
-            // to change transition action position when parent of state/target changes
-            connect(newParent, &CyberiadaSMEditorAbstractItem::geometryChanged,
-                    this, &CyberiadaSMEditorAbstractItem::onParentGeometryChanged);
-            // change in parent size
-            // to change position of children
-            connect(newParent, &CyberiadaSMEditorAbstractItem::sizeChanged,
-                    this, &CyberiadaSMEditorAbstractItem::onParentSizeChanged);
-            // change in this item geometry
-            // to change size of parent when child moves inside
-            // connect(this, &CyberiadaSMEditorAbstractItem::geometryChanged,
-            //         newParent, &CyberiadaSMEditorAbstractItem::onChildGeometryChanged);
-        }
-        StateRegion* stateArea = dynamic_cast<StateRegion*>(parent);
-        if(stateArea) {
-            newParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(stateArea->parentItem());
-            if(newParent) {
-                prevItemUnderCursor = newParent;
-                // change in parent geometry
-                connect(newParent, &CyberiadaSMEditorAbstractItem::geometryChanged,
-                        this, &CyberiadaSMEditorAbstractItem::onParentGeometryChanged);
-                // change in parent size
-                // to change position of children
-                connect(newParent, &CyberiadaSMEditorAbstractItem::sizeChanged,
-                        this, &CyberiadaSMEditorAbstractItem::onParentSizeChanged);
-                // change in this item geometry
-                // connect(this, &CyberiadaSMEditorAbstractItem::geometryChanged,
-                //         newParent, &CyberiadaSMEditorAbstractItem::onChildGeometryChanged);
-            }
-        }
-    }
+    parentContainer = nullptr;
+    connectParentContainer();
 }
 
 QVariant CyberiadaSMEditorAbstractItem::data(int key) const
@@ -131,6 +95,19 @@ void CyberiadaSMEditorAbstractItem::syncFromModel()
     update();
 }
 
+void CyberiadaSMEditorAbstractItem::refreshGeometry()
+{
+}
+
+bool CyberiadaSMEditorAbstractItem::isFrameExposed(const QRectF& frame, qreal width, const QRectF& exposed)
+{
+    // the antialiased outline spreads a pixel further
+    qreal margin = width + 1;
+    QRectF outer = frame.adjusted(-margin, -margin, margin, margin);
+    QRectF inner = frame.adjusted(margin, margin, -margin, -margin);
+    return outer.intersects(exposed) && !inner.contains(exposed);
+}
+
 void CyberiadaSMEditorAbstractItem::onParentGeometryChanged() {
     update();
     emit geometryChanged();
@@ -159,15 +136,16 @@ void CyberiadaSMEditorAbstractItem::onParentSizeChanged(CornerFlags side, qreal
         }
 
         Cyberiada::Rect oldR = collection->get_geometry_rect();
-        qDebug() << "--child old:" << oldR.x << oldR.y << oldR.width << oldR.height;
-        qDebug() << "--new:" << tmpR.x() << tmpR.y() << tmpR.width() << tmpR.height();
-        qDebug() << "--delta" << oldR.x - tmpR.x();
+        EDITOR_DEBUG(lcEditorItems) << "--child old:" << oldR.x << oldR.y << oldR.width << oldR.height;
+        EDITOR_DEBUG(lcEditorItems) << "--new:" << tmpR.x() << tmpR.y() << tmpR.width() << tmpR.height();
+        EDITOR_DEBUG(lcEditorItems) << "--delta" << oldR.x - tmpR.x();
 
         Cyberiada::Rect newR = Cyberiada::Rect(tmpR.x(),
                                             tmpR.y(),
                                             tmpR.width(),
                                             tmpR.height());
         model->updateGeometry(model->elementToIndex(element), newR);
+        refreshGeometry();
     }
 }
 
@@ -329,14 +307,16 @@ void CyberiadaSMEditorAbstractItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *ev
     QGraphicsItem::hoverLeaveEvent( event );
 }
 
-void CyberiadaSMEditorAbstractItem::slotInspectorModeChanged(bool on)
+void CyberiadaSMEditorAbstractItem::inspectorModeChanged(bool on)
 {
-    update();
+    Q_UNUSED(on);
 }
 
-void CyberiadaSMEditorAbstractItem::slotSelectionSettingsChanged()
+const CyberiadaSMEditorStyle& CyberiadaSMEditorAbstractItem::style() const
 {
-    update();
+    CyberiadaSMEditorScene* cScene = static_cast<CyberiadaSMEditorScene*>(scene());
+    MY_ASSERT(cScene);
+    return cScene->getStyle();
 }
 
 void CyberiadaSMEditorAbstractItem::hoverMoveEvent(QGraphicsSceneHoverEvent *event)
@@ -425,6 +405,7 @@ void CyberiadaSMEditorAbstractItem::resizeRight(const QPointF &pt)
                                         tmpRect.width(),
                                         tmpRect.height());
     model->updateGeometry(model->elementToIndex(element), r);
+    refreshGeometry();
     emit sizeChanged(CornerFlags::Right, delta);
 }
 
@@ -447,6 +428,7 @@ void CyberiadaSMEditorAbstractItem::resizeBottom(const QPointF &pt)
                                         tmpRect.width(),
                                         tmpRect.height());
     model->updateGeometry(model->elementToIndex(element), r);
+    refreshGeometry();
     emit sizeChanged(CornerFlags::Bottom, delta);
 }
 
@@ -459,16 +441,17 @@ void CyberiadaSMEditorAbstractItem::updatePosGeometry()
                                         pos().y(),
                                         boundingRect().width(),
                                         boundingRect().height());
-    if (type() == StateItem || type() == CompositeStateItem) {
+    if (lcEditorItems().isDebugEnabled() && (type() == StateItem || type() == CompositeStateItem)) {
         auto coll = dynamic_cast<Cyberiada::ElementCollection*>(element);
         Cyberiada::Rect oldR = coll->get_geometry_rect();
         QRectF parR = mapRectToParent(QRectF(boundingRect()));
-        qDebug() << "++child old:" << oldR.x << oldR.y << oldR.width << oldR.height;
-        qDebug() << "++new:" << r.x << r.y << r.width << r.height;
-        qDebug() << "++delta" << oldR.x - r.x;
-        qDebug() << "++mapBR" << parR;
+        EDITOR_DEBUG(lcEditorItems) << "++child old:" << oldR.x << oldR.y << oldR.width << oldR.height;
+        EDITOR_DEBUG(lcEditorItems) << "++new:" << r.x << r.y << r.width << r.height;
+        EDITOR_DEBUG(lcEditorItems) << "++delta" << oldR.x - r.x;
+        EDITOR_DEBUG(lcEditorItems) << "++mapBR" << parR;
     }
     model->updateGeometry(model->elementToIndex(element), r);
+    refreshGeometry();
 }
 
 void CyberiadaSMEditorAbstractItem::initializeDots()
@@ -481,15 +464,40 @@ void CyberiadaSMEditorAbstractItem::initializeDots()
 
 // change of parent
 void CyberiadaSMEditorAbstractItem::handleParentChange() {
-    // if (auto oldParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(parentItem())) {
-    //     disconnect(oldParent, &CyberiadaSMEditorAbstractItem::geometryChanged,
-    //                this, &CyberiadaSMEditorAbstractItem::onParentGeometryChanged);
-    // }
+    if (parentContainer) {
+        disconnect(parentContainer, &CyberiadaSMEditorAbstractItem::geometryChanged,
+                   this, &CyberiadaSMEditorAbstractItem::onParentGeometryChanged);
+        disconnect(parentContainer, &CyberiadaSMEditorAbstractItem::sizeChanged,
+                   this, &CyberiadaSMEditorAbstractItem::onParentSizeChanged);
+        parentContainer = nullptr;
+    }
+    connectParentContainer();
+}
 
-    // if (auto newParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(parentItem())) {
-    //     connect(newParent, &CyberiadaSMEditorAbstractItem::geometryChanged,
-    //             this, &CyberiadaSMEditorAbstractItem::onParentGeometryChanged);
-    // }
+void CyberiadaSMEditorAbstractItem::connectParentContainer()
+{
+    // the children of a composite state are the children of its region
+    QGraphicsItem* parent = parentItem();
+    CyberiadaSMEditorAbstractItem* newParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(parent);
+    if (newParent == nullptr && dynamic_cast<StateRegion*>(parent)) {
+        newParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(parent->parentItem());
+    }
+    if (newParent == nullptr) return;
+
+    parentContainer = newParent;
+    prevItemUnderCursor = newParent;
+    // change in parent geometry
+    // to change transition action position when parent of state/target changes
+    connect(newParent, &CyberiadaSMEditorAbstractItem::geometryChanged,
+            this, &CyberiadaSMEditorAbstractItem::onParentGeometryChanged);
+    // change in parent size
+    // to change position of children
+    connect(newParent, &CyberiadaSMEditorAbstractItem::sizeChanged,
+            this, &CyberiadaSMEditorAbstractItem::onParentSizeChanged);
+    // change in this item geometry
+    // to change size of parent when child moves inside
+    // connect(this, &CyberiadaSMEditorAbstractItem::geometryChanged,
+    //         newParent, &CyberiadaSMEditorAbstractItem::onChildGeometryChanged);
 }
 
 void CyberiadaSMEditorAbstractItem::setDotsPosition()
@@ -526,19 +534,8 @@ void CyberiadaSMEditorAbstractItem::hideDots()
 CyberiadaSMEditorAbstractItem *CyberiadaSMEditorAbstractItem::collectionUnderItem()
 {
     QPointF center = mapToScene(boundingRect().center());
-    QList<QGraphicsItem*> items = scene()->items(center);
-
-    CyberiadaSMEditorAbstractItem* cItem = nullptr;
-    for (QGraphicsItem* item : items) {
-        cItem = dynamic_cast<CyberiadaSMEditorAbstractItem*>(item);
-        if (!cItem) { continue; }
-        if (cItem == this) { continue; }
-
-        if (cItem->type() == CyberiadaSMEditorAbstractItem::StateItem ||
-            cItem->type() == CyberiadaSMEditorAbstractItem::CompositeStateItem ||
-            cItem->type() == CyberiadaSMEditorAbstractItem::SMItem) {
-            return cItem;
-        }
-    }
-    return nullptr;
+    CyberiadaSMEditorScene* cScene = dynamic_cast<CyberiadaSMEditorScene*>(scene());
+    if (!cScene) return nullptr;
+    // the item cannot be dropped into itself or into its own children
+    return cScene->containerAt(center, this);
 }
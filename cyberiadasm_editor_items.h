@@ -27,10 +27,25 @@
 #include <QGraphicsItem>
 #include <QObject>
 #include <QBrush>
+#include <QColor>
 
 #include "cyberiadasm_model.h"
 #include "dotsignal.h"
 
+/* -----------------------------------------------------------------------------
+ * Item Style
+ * ----------------------------------------------------------------------------- */
+
+// The settings the items read while painting. The scene copies them from the
+// SettingsManager once per settings change, the paint() functions read the copy.
+struct CyberiadaSMEditorStyle {
+    QColor selectionColor;
+    int    selectionBorderWidth;
+    bool   inspectorMode;
+    bool   showText;
+    bool   showTransitionText;
+};
+
 /* -----------------------------------------------------------------------------
  * Abstract Item
  * ----------------------------------------------------------------------------- */
@@ -102,11 +117,18 @@ public:
 
     virtual void syncFromModel();
     virtual void updateSizeToFitChildren(CyberiadaSMEditorAbstractItem* child);
+    // called by the scene on the toggle, the scene repaints all items once
+    virtual void inspectorModeChanged(bool on);
 
 protected:
     CyberiadaSMModel* model;
     Cyberiada::Element* element;
 
+    const CyberiadaSMEditorStyle& style() const;
+    // whether the exposed area reaches the outline drawn along the frame
+    // (the large items skip painting when only their interior is exposed)
+    static bool isFrameExposed(const QRectF& frame, qreal width, const QRectF& exposed);
+
     void onParentGeometryChanged();
     virtual void onParentSizeChanged(CornerFlags side, qreal d);
     void onChildGeometryChanged();
@@ -125,10 +147,6 @@ signals:
     void sizeChanged(CornerFlags side, qreal d);
     void previousPositionChanged();
 
-private slots:
-    virtual void slotInspectorModeChanged(bool on);
-    virtual void slotSelectionSettingsChanged();
-
 protected:
     unsigned int cornerFlags;
     QPointF previousPosition;
@@ -145,6 +163,9 @@ protected:
 
     void updatePosGeometry();
     void updateSizeGeometry();
+    // re-reads the cached element geometry; called right after the item writes
+    // the geometry, the model notifications are deferred during a transaction
+    virtual void refreshGeometry();
 
     virtual void initializeDots();
     virtual void setDotsPosition();
@@ -154,7 +175,12 @@ protected:
     CyberiadaSMEditorAbstractItem* collectionUnderItem();
 
 private:
+    // the element parent item the item follows (a composite state for the
+    // children of its region); rewired when the item is reparented
+    CyberiadaSMEditorAbstractItem* parentContainer;
+
     void handleParentChange();
+    void connectParentContainer();
 };
 
 #endif
@@ -0,0 +1,35 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ * 
+ * The State Machine Editor Diagnostics
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#include "cyberiadasm_editor_logging.h"
+
+Q_LOGGING_CATEGORY(lcEditorScene, "cyberiada.editor.scene", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcEditorItems, "cyberiada.editor.items", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcEditorTransition, "cyberiada.editor.transition", QtInfoMsg)
+
+void enableEditorTracing(bool on)
+{
+    QLoggingCategory::setFilterRules(on ?
+                                     QStringLiteral("cyberiada.editor.*.debug=true") :
+                                     QStringLiteral("cyberiada.editor.*.debug=false"));
+}
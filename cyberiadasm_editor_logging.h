@@ -0,0 +1,56 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ * 
+ * The State Machine Editor Diagnostics
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef CYBERIADA_SM_EDITOR_LOGGING_HEADER
+#define CYBERIADA_SM_EDITOR_LOGGING_HEADER
+
+#include <QLoggingCategory>
+
+/* -----------------------------------------------------------------------------
+ * Logging Categories
+ * ----------------------------------------------------------------------------- */
+
+// The editor diagnostics are printed with EDITOR_DEBUG(category), a qCDebug()
+// whose message arguments are evaluated only when the category is enabled.
+// The debug level is off by default and is switched on at runtime, in any
+// build, with --trace or with the QT_LOGGING_RULES variable (e.g.
+// "cyberiada.editor.scene.debug=true"). Configured with
+// CYBERIADA_EDITOR_TRACING=OFF, the build removes the editor messages
+// completely; the other debug output of the application is kept.
+#ifdef CYBERIADA_EDITOR_NO_TRACING
+#define EDITOR_DEBUG(category) QT_NO_QDEBUG_MACRO()
+#else
+#define EDITOR_DEBUG(category) qCDebug(category)
+#endif
+
+// scene building and synchronization with the model
+Q_DECLARE_LOGGING_CATEGORY(lcEditorScene)
+// state and comment item geometry (moving, resizing, fitting the children)
+Q_DECLARE_LOGGING_CATEGORY(lcEditorItems)
+// transition item editing
+Q_DECLARE_LOGGING_CATEGORY(lcEditorTransition)
+
+// enables the debug level of all editor categories
+void enableEditorTracing(bool on);
+
+#endif
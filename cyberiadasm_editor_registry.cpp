@@ -0,0 +1,69 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ * 
+ * The State Machine Editor Scene Item Registry
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#include "cyberiadasm_editor_registry.h"
+#include "myassert.h"
+
+void CyberiadaSMEditorItemRegistry::insert(const Cyberiada::ID& id, QGraphicsItem* item)
+{
+    MY_ASSERT(item);
+    // re-registering an id replaces the previous item
+    remove(id);
+    removeItem(item);
+    idToItem[id] = item;
+    itemToId.insert(item, id);
+}
+
+void CyberiadaSMEditorItemRegistry::remove(const Cyberiada::ID& id)
+{
+    ItemHash::iterator i = idToItem.find(id);
+    if (i == idToItem.end()) return;
+    itemToId.remove(i->second);
+    idToItem.erase(i);
+}
+
+void CyberiadaSMEditorItemRegistry::removeItem(const QGraphicsItem* item)
+{
+    QHash<const QGraphicsItem*, Cyberiada::ID>::iterator i = itemToId.find(item);
+    if (i == itemToId.end()) return;
+    idToItem.erase(i.value());
+    itemToId.erase(i);
+}
+
+void CyberiadaSMEditorItemRegistry::clear()
+{
+    idToItem.clear();
+    itemToId.clear();
+}
+
+QGraphicsItem* CyberiadaSMEditorItemRegistry::item(const Cyberiada::ID& id) const
+{
+    ItemHash::const_iterator i = idToItem.find(id);
+    if (i == idToItem.end()) return NULL;
+    return i->second;
+}
+
+Cyberiada::ID CyberiadaSMEditorItemRegistry::id(const QGraphicsItem* item) const
+{
+    return itemToId.value(item);
+}
@@ -0,0 +1,66 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ * 
+ * The State Machine Editor Scene Item Registry
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef CYBERIADA_SM_EDITOR_REGISTRY_HEADER
+#define CYBERIADA_SM_EDITOR_REGISTRY_HEADER
+
+#include <QGraphicsItem>
+#include <QHash>
+#include <unordered_map>
+
+#include "cyberiadasm_model.h"
+
+/* -----------------------------------------------------------------------------
+ * Item Registry
+ * ----------------------------------------------------------------------------- */
+
+// The scene items indexed by the element id in both directions: every lookup
+// (id -> item while painting the transitions, item -> id on the selection
+// change) is a hash lookup instead of a map search or a linear scan. The
+// scene re-keys an item when the model changes the id of its element.
+class CyberiadaSMEditorItemRegistry {
+public:
+    typedef std::unordered_map<Cyberiada::ID, QGraphicsItem*> ItemHash;
+    typedef ItemHash::const_iterator const_iterator;
+
+    void  insert(const Cyberiada::ID& id, QGraphicsItem* item);
+    void  remove(const Cyberiada::ID& id);
+    void  removeItem(const QGraphicsItem* item);
+    void  clear();
+
+    QGraphicsItem* item(const Cyberiada::ID& id) const;
+    Cyberiada::ID  id(const QGraphicsItem* item) const;
+    bool  contains(const Cyberiada::ID& id) const { return idToItem.count(id) > 0; }
+    bool  contains(const QGraphicsItem* item) const { return itemToId.contains(item); }
+    bool  isEmpty() const { return idToItem.empty(); }
+    int   size() const { return int(idToItem.size()); }
+
+    const_iterator begin() const { return idToItem.begin(); }
+    const_iterator end() const { return idToItem.end(); }
+
+private:
+    ItemHash                                   idToItem;
+    QHash<const QGraphicsItem*, Cyberiada::ID> itemToId;
+};
+
+#endif
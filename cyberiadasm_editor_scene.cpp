@@ -28,8 +28,13 @@
 #include <QPainter>
 #include <QGraphicsView>
 #include <QGraphicsScene>
+#include <QGraphicsSceneMouseEvent>
 #include <QCursor>
 #include <QMessageBox>
+#include <QStyleOptionGraphicsItem>
+#include <QVector>
+#include <cmath>
+#include <algorithm>
 
 #include "cyberiadasm_editor_scene.h"
 #include "cyberiadasm_editor_items.h"
@@ -40,7 +45,10 @@
 #include "cyberiadasm_editor_comment_item.h"
 #include "smeditor_window.h"
 #include "settings_manager.h"
+#include "fontmanager.h"
+#include "editable_text_item.h"
 #include "myassert.h"
+#include "cyberiadasm_editor_logging.h"
 
 static double DEFAULT_SCENE_X = -500;
 static double DEFAULT_SCENE_Y = -500;
@@ -50,27 +58,58 @@ static double DEFAULT_SCENE_DELTA = 0.2;
 static double DEFAULT_SCENE_BORDER_MARGIN = 50;
 
 CyberiadaSMEditorScene::CyberiadaSMEditorScene(CyberiadaSMModel* _model, QObject *_parent):
-    QGraphicsScene(_parent), model(_model), currentSM(NULL)
+    QGraphicsScene(_parent), model(_model), currentSM(NULL), pendingMove(NULL), syncing(false),
+    selectionGuard(false)
 {
     // gridSize = 25;
     // gridEnabled = true;
     // gridSnap = true;
     gridPen = QPen(Qt::gray, 0, Qt::DotLine);
     connect(&SettingsManager::instance(), &SettingsManager::gridSettingsChanged, this, &CyberiadaSMEditorScene::slotGridSettingsChanged);
+    connect(&SettingsManager::instance(), &SettingsManager::inspectorModeChanged, this, &CyberiadaSMEditorScene::slotInspectorModeChanged);
+    connect(&SettingsManager::instance(), &SettingsManager::selectionSettingsChanged, this, &CyberiadaSMEditorScene::slotSelectionSettingsChanged);
+    connect(&SettingsManager::instance(), &SettingsManager::showTransitionTextChanged, this, &CyberiadaSMEditorScene::slotShowTransitionTextChanged);
+    connect(&FontManager::instance(), &FontManager::fontChanged, this, &CyberiadaSMEditorScene::slotFontChanged);
+    updateStyle();
+    connect(this, &QGraphicsScene::sceneRectChanged, this, &CyberiadaSMEditorScene::slotBackgroundChanged);
 
 	setBackgroundBrush(Qt::white);
     connect(this, &QGraphicsScene::selectionChanged, this, &CyberiadaSMEditorScene::slotSelectionChanged);
     connect(model, &CyberiadaSMModel::dataChanged, this, &CyberiadaSMEditorScene::slotModelDataChanged);
+    connect(model, &CyberiadaSMModel::elementInserted, this, &CyberiadaSMEditorScene::slotElementInserted);
+    connect(model, &CyberiadaSMModel::elementAboutToBeRemoved, this, &CyberiadaSMEditorScene::slotElementAboutToBeRemoved);
+    connect(model, &CyberiadaSMModel::elementMoved, this, &CyberiadaSMEditorScene::slotElementMoved);
+    connect(model, &CyberiadaSMModel::elementIdChanged, this, &CyberiadaSMEditorScene::slotElementIdChanged);
+    // the base class signal: CyberiadaSMModel declares one of the same name
+    // that is never emitted
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &CyberiadaSMEditorScene::slotModelAboutToBeReset);
+    dragTimer.setSingleShot(true);
+    dragTimer.setInterval(DRAG_FRAME_INTERVAL_MS);
+    connect(&dragTimer, &QTimer::timeout, this, &CyberiadaSMEditorScene::slotFlushDrag);
+    // a zero interval: the queued syncs run once the current events are handled
+    syncTimer.setSingleShot(true);
+    syncTimer.setInterval(0);
+    connect(&syncTimer, &QTimer::timeout, this, &CyberiadaSMEditorScene::slotFlushSync);
     reset();
 }
 
 CyberiadaSMEditorScene::~CyberiadaSMEditorScene()
 {
+    discardPendingDrag();
 }
 
 void CyberiadaSMEditorScene::reset()
 {
+	discardPendingDrag();
+	discardPendingSync();
 	clear();
+	itemRegistry.clear();
+	currentSM = NULL;
+	currentSMId.clear();
+	contentRect = QRectF();
+	contentShrinkPending = false;
+	spatialIndex.clear();
+	spatialIndexDirty = true;
 	setSceneRect(DEFAULT_SCENE_X,
 				 DEFAULT_SCENE_Y,
 				 DEFAULT_SCENE_WIDTH,
@@ -78,7 +117,103 @@ void CyberiadaSMEditorScene::reset()
 	update();
 }
 
+static void copyMouseMove(const QGraphicsSceneMouseEvent* from, QGraphicsSceneMouseEvent* to, bool keepLast)
+{
+    to->setWidget(from->widget());
+    to->setPos(from->pos());
+    to->setScenePos(from->scenePos());
+    to->setScreenPos(from->screenPos());
+    if (!keepLast) {
+        to->setLastPos(from->lastPos());
+        to->setLastScenePos(from->lastScenePos());
+        to->setLastScreenPos(from->lastScreenPos());
+    }
+    const Qt::MouseButton buttons[] = { Qt::LeftButton, Qt::RightButton, Qt::MiddleButton };
+    for (Qt::MouseButton b : buttons) {
+        to->setButtonDownPos(b, from->buttonDownPos(b));
+        to->setButtonDownScenePos(b, from->buttonDownScenePos(b));
+        to->setButtonDownScreenPos(b, from->buttonDownScreenPos(b));
+    }
+    to->setButtons(from->buttons());
+    to->setButton(from->button());
+    to->setModifiers(from->modifiers());
+    to->setSource(from->source());
+    to->setFlags(from->flags());
+}
+
+void CyberiadaSMEditorScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
+{
+    if (mouseGrabberItem() == NULL || !(event->buttons() & Qt::LeftButton)) {
+        // hovering is delivered at once
+        slotFlushDrag();
+        dispatchMouseMove(event);
+        return;
+    }
+    // a drag or a resize: the mice report far more moves than the screen
+    // shows frames, only the latest one is applied once per frame (the items
+    // compute their geometry from the press position, not from the steps)
+    if (pendingMove == NULL) {
+        pendingMove = new QGraphicsSceneMouseEvent(QEvent::GraphicsSceneMouseMove);
+        copyMouseMove(event, pendingMove, false);
+        dragTimer.start();
+    } else {
+        copyMouseMove(event, pendingMove, true);
+    }
+    event->accept();
+}
+
+void CyberiadaSMEditorScene::dispatchMouseMove(QGraphicsSceneMouseEvent* event)
+{
+    // dragging a selection or resizing a state updates many elements per
+    // event, the views are notified once the whole event is handled
+    if (mouseGrabberItem() != NULL && (event->buttons() & Qt::LeftButton)) {
+        // the frames of a drag are undone as one step
+        model->beginContinuousEdit();
+    }
+    model->beginTransaction();
+    QGraphicsScene::mouseMoveEvent(event);
+    model->commitTransaction();
+}
+
+void CyberiadaSMEditorScene::slotFlushDrag()
+{
+    if (pendingMove == NULL) {
+        return;
+    }
+    dragTimer.stop();
+    QGraphicsSceneMouseEvent* move = pendingMove;
+    pendingMove = NULL;
+    dispatchMouseMove(move);
+    delete move;
+}
+
+void CyberiadaSMEditorScene::discardPendingDrag()
+{
+    dragTimer.stop();
+    delete pendingMove;
+    pendingMove = NULL;
+}
+
+void CyberiadaSMEditorScene::discardPendingSync()
+{
+    syncTimer.stop();
+    syncQueue.clear();
+    syncQueued.clear();
+}
+
+void CyberiadaSMEditorScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
+{
+    // the last buffered move lands before the release
+    slotFlushDrag();
+    QGraphicsScene::mouseReleaseEvent(event);
+    // the drag is over: the next drag is a separate undo step
+    model->endContinuousEdit();
+}
+
 void CyberiadaSMEditorScene::slotSelectionChanged() {
+    if (selectionGuard) {
+        return;
+    }
     if (selectedItems().size() > 0) {
         QGraphicsItem* currItem = nullptr;
         for (QGraphicsItem *item : selectedItems()) {
@@ -87,7 +222,7 @@ void CyberiadaSMEditorScene::slotSelectionChanged() {
             }
         }
         if (currItem == nullptr) return;
-        Cyberiada::ID item_id = elementIdToItemMap.key(currItem);
+        Cyberiada::ID item_id = itemRegistry.id(currItem);
         const Cyberiada::Element* element = model->idToElement(QString::fromStdString(item_id));
 
         if(!element) return;
@@ -99,6 +234,14 @@ void CyberiadaSMEditorScene::slotSelectionChanged() {
 	}
 }
 
+static Cyberiada::StateMachine* parentStateMachine(Cyberiada::Element* element)
+{
+    while (element && element->get_type() != Cyberiada::elementSM) {
+        element = element->get_parent();
+    }
+    return static_cast<Cyberiada::StateMachine*>(element);
+}
+
 void CyberiadaSMEditorScene::slotElementSelected(const QModelIndex& index)
 {
     if (index.isValid() && index != model->rootIndex() && index != model->documentIndex()) {
@@ -106,44 +249,29 @@ void CyberiadaSMEditorScene::slotElementSelected(const QModelIndex& index)
         const Cyberiada::ID element_id = element->get_id().c_str();
         MY_ASSERT(element);
 
-        blockSignals(true);
+        // the machines are built one at a time, when first shown
+        // the selection follows the tree, it is not reported back to it;
+        // the other scene signals (the scene rect, the updates) still reach
+        // the views while another machine is built
+        selectionGuard = true;
+        Cyberiada::StateMachine* sm = parentStateMachine(element);
+        if (sm && sm != currentSM) {
+            showStateMachine(sm);
+        }
+
         clearSelection();
-        blockSignals(false);
 
-        QGraphicsItem* item = elementIdToItemMap.value(element_id);
+        QGraphicsItem* item = itemRegistry.item(element_id);
         if (item) {
-            blockSignals(true);
             item->setSelected(true);
-            blockSignals(false);
-        }
-
-        // Cyberiada::StateMachine* sm = model->rootDocument()->get_parent_sm(element);
-        // if (sm != currentSM) {
-        //     currentSM = sm;
-        //     /*Cyberiada::Rect bound = currentSM->get_bound_rect();
-        //     clear();
-        //     if (bound.valid) {
-        //         setSceneRect(-(bound.width / 2.0) * (1.0 + DEFAULT_SCENE_DELTA),
-        //                      -(bound.height / 2.0) * (1.0 + DEFAULT_SCENE_DELTA),
-        //                      bound.width * (1.0 + 2.0 * DEFAULT_SCENE_DELTA),
-        //                      bound.height * (1.0 + 2.0 * DEFAULT_SCENE_DELTA));
-        //         QRectF r = sceneRect();
-        //         qDebug() << "Scene (" << r.left() << ", " << r.top() << ", " << r.right() << ", " << r.bottom() << ")";
-        //     } else {
-        //         //reconstructGeometry();
-        //     }*/
-
-        //     addItemsRecursively(NULL, currentSM);
-        //     // TODO
-        //     views().first()->fitInView(itemsBoundingRect(), Qt::KeepAspectRatio);
-        //     update();
-        // }
+        }
+        selectionGuard = false;
 	}
 }
 
 void CyberiadaSMEditorScene::updateItemsRecursively(CyberiadaSMEditorAbstractItem* parent, Cyberiada::ElementCollection* collection)
 {
-    CyberiadaSMEditorAbstractItem* current_item = static_cast<CyberiadaSMEditorAbstractItem*>(elementIdToItemMap.value(collection->get_id()));
+    CyberiadaSMEditorAbstractItem* current_item = static_cast<CyberiadaSMEditorAbstractItem*>(itemRegistry.item(collection->get_id()));
     current_item->syncFromModel();
 
     // updating children
@@ -158,6 +286,9 @@ void CyberiadaSMEditorScene::updateItemsRecursively(CyberiadaSMEditorAbstractIte
 
 void CyberiadaSMEditorScene::deleteItemsRecursively(Cyberiada::Element *element)
 {
+    // the whole subtree with its transitions is undone as a single step;
+    // the items are released by slotElementAboutToBeRemoved()
+    model->beginTransaction();
     Cyberiada::ElementType type = element->get_type();
 
     if(type == Cyberiada::elementCompositeState || type == Cyberiada::elementSM || type == Cyberiada::elementRoot) {
@@ -169,45 +300,356 @@ void CyberiadaSMEditorScene::deleteItemsRecursively(Cyberiada::Element *element)
         }
     }
 
-    // remove transitions
-    QList<Cyberiada::ID> toRemove;
-    for (auto it = elementIdToItemMap.begin(); it != elementIdToItemMap.end(); ++it) {
-        QGraphicsItem* item = it.value();
-
-        auto* transition = dynamic_cast<CyberiadaSMEditorTransitionItem*>(item);
-        if (transition) {
-            if(transition->sourceId() == element->get_id() || transition->targetId() == element->get_id()) {
-                toRemove.append(it.key());
-                QModelIndex i = transition->getIndex();
-                delete transition;
-                model->deleteElement(i);
-            }
-        }
-    }
-    for (const Cyberiada::ID& id : toRemove) {
-        elementIdToItemMap.remove(id);
+    // remove transitions: only the ones incident to the element are visited
+    QList<Cyberiada::Transition*> toRemove = model->elementTransitions(element);
+    for (Cyberiada::Transition* trans : toRemove) {
+        model->deleteElement(model->elementToIndex(trans));
     }
 
     // remove element
-    CyberiadaSMEditorAbstractItem* citem = dynamic_cast<CyberiadaSMEditorAbstractItem*>(elementIdToItemMap.value(element->get_id()));
     Cyberiada::ElementCollection* parent_element = dynamic_cast<Cyberiada::ElementCollection*>(element->get_parent());
     MY_ASSERT(parent_element);
-    elementIdToItemMap.remove(element->get_id());
-    QModelIndex i = citem->getIndex();
-    delete citem;
-    model->deleteElement(i);
+    model->deleteElement(model->elementToIndex(element));
+    model->commitTransaction();
 }
 
 void CyberiadaSMEditorScene::slotModelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
-    Cyberiada::Element* element = model->indexToElement(topLeft);
-    // поиск CyberiadaSMEditorAbstractItem по QMap QMap<Cyberiada::ID, QGraphicsItem*> elementIdToItemMap;
-    // updateItemsRecursively(nullptr, static_cast<Cyberiada::ElementCollection*>(element));
-    CyberiadaSMEditorAbstractItem* current_item = dynamic_cast<CyberiadaSMEditorAbstractItem*>(elementIdToItemMap.value(element->get_id()));
+    // the items are synced later, once per event loop turn: a sync never
+    // runs inside the model notification that caused it
+    if (syncing) {
+        qCWarning(lcEditorScene) << "the model has been changed during the scene sync";
+    }
+    queueSync(model->indexToElement(topLeft));
+}
+
+void CyberiadaSMEditorScene::slotModelAboutToBeReset()
+{
+    // the queued elements belong to the document about to be deleted
+    discardPendingSync();
+}
+
+void CyberiadaSMEditorScene::queueSync(Cyberiada::Element* element)
+{
+    // the other machines have no items
+    if (element == NULL || syncQueued.contains(element) || !isShown(element)) {
+        return;
+    }
+    syncQueued.insert(element);
+    syncQueue.append(element);
+    if (!syncTimer.isActive()) {
+        syncTimer.start();
+    }
+}
+
+void CyberiadaSMEditorScene::unqueueSync(Cyberiada::Element* element)
+{
+    if (syncQueue.isEmpty()) {
+        return;
+    }
+    if (syncQueued.remove(element)) {
+        syncQueue.removeOne(element);
+    }
+    if (element->has_children()) {
+        const Cyberiada::ElementList& children = static_cast<Cyberiada::ElementCollection*>(element)->get_children();
+        for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+            unqueueSync(*i);
+        }
+    }
+}
+
+static int elementDepth(const Cyberiada::Element* element)
+{
+    int depth = 0;
+    for (; element; element = element->get_parent()) {
+        depth++;
+    }
+    return depth;
+}
+
+static bool lessDepth(const QPair<int, Cyberiada::Element*>& a, const QPair<int, Cyberiada::Element*>& b)
+{
+    return a.first < b.first;
+}
+
+void CyberiadaSMEditorScene::slotFlushSync()
+{
+    if (syncQueue.isEmpty() || syncing) {
+        return;
+    }
+    syncTimer.stop();
+    // the parents go first: the children are placed in the synced parents;
+    // the siblings keep the order of their changes
+    QVector<QPair<int, Cyberiada::Element*> > ordered;
+    ordered.reserve(syncQueue.size());
+    for (Cyberiada::Element* element : syncQueue) {
+        ordered.append(qMakePair(elementDepth(element), element));
+    }
+    syncQueue.clear();
+    syncQueued.clear();
+    std::stable_sort(ordered.begin(), ordered.end(), lessDepth);
+
+    // the items only read the model here
+    syncing = true;
+    bool machineChanged = false;
+    for (const QPair<int, Cyberiada::Element*>& entry : ordered) {
+        if (syncElement(entry.second) && entry.second->get_type() != Cyberiada::elementSM) {
+            machineChanged = true;
+        }
+    }
+    if (machineChanged) {
+        syncMachineItem();
+    }
+    syncing = false;
+    // no scene-wide update: the synced items invalidate their own old and
+    // new bounds (setPos(), prepareGeometryChange(), update()); the machine
+    // item is repainted only when its frame changes (see --repaint in
+    // docs/TESTING.md)
+}
+
+bool CyberiadaSMEditorScene::syncElement(Cyberiada::Element* element)
+{
+    CyberiadaSMEditorAbstractItem* current_item = dynamic_cast<CyberiadaSMEditorAbstractItem*>(itemRegistry.item(element->get_id()));
     if (current_item != nullptr) {
+        QRectF old_bounds = current_item->sceneBoundingRect();
         current_item->syncFromModel();
+        if (current_item->isVisible()) {
+            updateContentRect(old_bounds, current_item->sceneBoundingRect());
+        }
+        if (!spatialIndexDirty) {
+            // the moved item carries its descendants along; the descendants
+            // that keep their scene rects (a resize) cost a lookup each
+            int depth = 0;
+            for (QGraphicsItem* p = current_item->parentItem(); p != NULL; p = p->parentItem()) {
+                if (dynamic_cast<CyberiadaSMEditorAbstractItem*>(p)) {
+                    depth++;
+                }
+            }
+            indexItems(current_item, depth);
+        }
     }
-    update();
+    if (element->get_type() != Cyberiada::elementTransition) {
+        // the transitions cache their paths: the attached ones follow the vertex
+        for (Cyberiada::Transition* trans : model->elementTransitions(element)) {
+            auto* transition = dynamic_cast<CyberiadaSMEditorTransitionItem*>(itemRegistry.item(trans->get_id()));
+            if (transition) {
+                transition->invalidatePath();
+            }
+        }
+    }
+    return current_item != nullptr;
+}
+
+bool CyberiadaSMEditorScene::isShown(Cyberiada::Element* element) const
+{
+    return currentSM != NULL && parentStateMachine(element) == currentSM;
+}
+
+QGraphicsItem* CyberiadaSMEditorScene::containerItem(Cyberiada::Element* element)
+{
+    QGraphicsItem* item = itemRegistry.item(element->get_id());
+    if (item && item->type() == CyberiadaSMEditorAbstractItem::StateItem) {
+        // the children of a composite state are placed in its region
+        CyberiadaSMEditorStateItem* state = static_cast<CyberiadaSMEditorStateItem*>(item);
+        if (state->getRegion() == nullptr) {
+            // the first child turns a simple state into a composite one
+            state->syncFromModel();
+        }
+        return state->getRegion();
+    }
+    return item;
+}
+
+void CyberiadaSMEditorScene::stackInDocumentOrder(QGraphicsItem* item, Cyberiada::Element* element)
+{
+    // the siblings stack in the document order, as if the scene was rebuilt;
+    // the new elements are appended, so the search starts from the end
+    const Cyberiada::ElementList& children = static_cast<Cyberiada::ElementCollection*>(element->get_parent())->get_children();
+    QGraphicsItem* next = NULL;
+    for (Cyberiada::ElementList::const_reverse_iterator i = children.rbegin(); i != children.rend() && *i != element; i++) {
+        QGraphicsItem* sibling = itemRegistry.item((*i)->get_id());
+        if (sibling && sibling->parentItem() == item->parentItem()) {
+            next = sibling;
+        }
+    }
+    if (next) {
+        item->stackBefore(next);
+    }
+}
+
+void CyberiadaSMEditorScene::invalidateTransitions(Cyberiada::Element* element)
+{
+    // the transitions cache their paths, the ones attached to the subtree are
+    // recomputed against the changed vertex items
+    if (element->get_type() == Cyberiada::elementTransition) {
+        auto* transition = dynamic_cast<CyberiadaSMEditorTransitionItem*>(itemRegistry.item(element->get_id()));
+        if (transition) {
+            transition->invalidatePath();
+        }
+        return;
+    }
+    for (Cyberiada::Transition* trans : model->elementTransitions(element)) {
+        auto* transition = dynamic_cast<CyberiadaSMEditorTransitionItem*>(itemRegistry.item(trans->get_id()));
+        if (transition) {
+            transition->invalidatePath();
+        }
+    }
+    if (element->has_children()) {
+        const Cyberiada::ElementList& children = static_cast<Cyberiada::ElementCollection*>(element)->get_children();
+        for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+            invalidateTransitions(*i);
+        }
+    }
+}
+
+void CyberiadaSMEditorScene::syncMachineItem()
+{
+    // the bounds of the shown machine include all its elements
+    CyberiadaSMEditorAbstractItem* smItem = dynamic_cast<CyberiadaSMEditorAbstractItem*>(itemRegistry.item(currentSMId));
+    if (smItem) {
+        smItem->syncFromModel();
+    }
+}
+
+void CyberiadaSMEditorScene::slotElementInserted(Cyberiada::Element* element)
+{
+    if (element->get_type() == Cyberiada::elementSM) {
+        // the machines are built on demand; a new one is shown on an empty scene
+        if (currentSM == NULL) {
+            showStateMachine(static_cast<Cyberiada::StateMachine*>(element));
+        }
+        return;
+    }
+    if (!isShown(element) || itemRegistry.item(element->get_id()) != NULL) {
+        return;
+    }
+    // the transitions are top level items
+    QGraphicsItem* parent = NULL;
+    if (element->get_type() != Cyberiada::elementTransition) {
+        parent = containerItem(element->get_parent());
+        if (parent == NULL) {
+            return;
+        }
+    }
+    QGraphicsItem* item = addElementItem(parent, element);
+    if (item == NULL) {
+        return;
+    }
+    stackInDocumentOrder(item, element);
+    invalidateTransitions(element);
+    queueSync(currentSM);
+    spatialIndexDirty = true;
+    if (item->isVisible()) {
+        updateContentRect(QRectF(), item->sceneBoundingRect());
+    }
+    EDITOR_DEBUG(lcEditorScene) << "inserted" << element->get_id().c_str();
+}
+
+void CyberiadaSMEditorScene::releaseItemsRecursively(Cyberiada::Element* element)
+{
+    // the child items go along with their parent item, only the registry
+    // entries are dropped; the transition items are top level
+    QGraphicsItem* item = itemRegistry.item(element->get_id());
+    if (item) {
+        itemRegistry.removeItem(item);
+        if (item->type() == CyberiadaSMEditorAbstractItem::TransitionItem) {
+            delete item;
+        }
+    }
+    if (element->has_children()) {
+        const Cyberiada::ElementList& children = static_cast<Cyberiada::ElementCollection*>(element)->get_children();
+        for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+            releaseItemsRecursively(*i);
+        }
+    }
+}
+
+void CyberiadaSMEditorScene::removeElementItems(Cyberiada::Element* element)
+{
+    QGraphicsItem* item = itemRegistry.item(element->get_id());
+    if (item && item->type() == CyberiadaSMEditorAbstractItem::TransitionItem) {
+        // deleted by the release below
+        item = NULL;
+    }
+    releaseItemsRecursively(element);
+    delete item;
+    spatialIndexDirty = true;
+    // the content may have shrunk, it is recomputed when asked for
+    contentShrinkPending = true;
+}
+
+void CyberiadaSMEditorScene::slotElementAboutToBeRemoved(Cyberiada::Element* element)
+{
+    if (element == currentSM) {
+        discardPendingSync();
+        removeElementItems(element);
+        currentSM = NULL;
+        currentSMId.clear();
+        return;
+    }
+    if (!isShown(element)) {
+        return;
+    }
+    // the queued changes of the subtree are dropped with it
+    unqueueSync(element);
+    if (itemRegistry.item(element->get_id()) == NULL) {
+        return;
+    }
+    removeElementItems(element);
+    invalidateTransitions(element);
+    queueSync(currentSM);
+    EDITOR_DEBUG(lcEditorScene) << "removed" << element->get_id().c_str();
+}
+
+void CyberiadaSMEditorScene::slotElementIdChanged(const QString& old_id, const QString& new_id)
+{
+    // the registry and the transition items look the items up by the
+    // current element ids
+    Cyberiada::ID id = new_id.toStdString();
+    if (currentSMId == old_id.toStdString()) {
+        currentSMId = id;
+    }
+    QGraphicsItem* item = itemRegistry.item(old_id.toStdString());
+    if (item) {
+        itemRegistry.insert(id, item);
+        EDITOR_DEBUG(lcEditorScene) << "renamed" << old_id << "to" << new_id;
+    }
+}
+
+void CyberiadaSMEditorScene::slotElementMoved(Cyberiada::Element* element)
+{
+    CyberiadaSMEditorAbstractItem* item = dynamic_cast<CyberiadaSMEditorAbstractItem*>(itemRegistry.item(element->get_id()));
+    if (!isShown(element)) {
+        // moved to another machine
+        unqueueSync(element);
+        if (item) {
+            removeElementItems(element);
+            queueSync(currentSM);
+        }
+        return;
+    }
+    if (item == NULL) {
+        // moved from another machine
+        slotElementInserted(element);
+        return;
+    }
+    QRectF old_bounds = item->sceneBoundingRect();
+    if (element->get_type() != Cyberiada::elementTransition) {
+        QGraphicsItem* parent = containerItem(element->get_parent());
+        MY_ASSERT(parent);
+        // the model coordinates are relative to the new parent, the item is
+        // placed by the next sync
+        item->setParentItem(parent);
+        queueSync(element);
+        stackInDocumentOrder(item, element);
+    }
+    invalidateTransitions(element);
+    queueSync(currentSM);
+    spatialIndexDirty = true;
+    if (item->isVisible()) {
+        updateContentRect(old_bounds, item->sceneBoundingRect());
+    }
+    EDITOR_DEBUG(lcEditorScene) << "moved" << element->get_id().c_str();
 }
 
 void CyberiadaSMEditorScene::slotSMSizeChanged(CyberiadaSMEditorAbstractItem::CornerFlags side, qreal d)
@@ -215,8 +657,71 @@ void CyberiadaSMEditorScene::slotSMSizeChanged(CyberiadaSMEditorAbstractItem::Co
     // TODO
 }
 
+void CyberiadaSMEditorScene::updateStyle()
+{
+    SettingsManager& sm = SettingsManager::instance();
+    style.selectionColor = sm.getSelectionColor();
+    style.selectionBorderWidth = sm.getSelectionBorderWidth();
+    style.inspectorMode = sm.getInspectorMode();
+    style.showText = sm.getShowText();
+    style.showTransitionText = sm.getShowTransitionText();
+}
+
+void CyberiadaSMEditorScene::slotInspectorModeChanged(bool on)
+{
+    updateStyle();
+    for (auto it = itemRegistry.begin(); it != itemRegistry.end(); ++it) {
+        CyberiadaSMEditorAbstractItem* item = dynamic_cast<CyberiadaSMEditorAbstractItem*>(it->second);
+        if (item) {
+            item->inspectorModeChanged(on);
+        }
+    }
+    // the inspector marks are a part of the cached background as well
+    slotBackgroundChanged();
+}
+
+void CyberiadaSMEditorScene::slotSelectionSettingsChanged()
+{
+    updateStyle();
+    update();
+}
+
+void CyberiadaSMEditorScene::slotShowTransitionTextChanged(bool on)
+{
+    updateStyle();
+    for (auto it = itemRegistry.begin(); it != itemRegistry.end(); ++it) {
+        if (it->second->type() == CyberiadaSMEditorAbstractItem::TransitionItem) {
+            static_cast<CyberiadaSMEditorTransitionItem*>(it->second)->setActionVisibility(on);
+        }
+    }
+    update();
+}
+
+void CyberiadaSMEditorScene::slotFontChanged(const QFont& font)
+{
+    // the text items are the direct children of the element items
+    for (auto it = itemRegistry.begin(); it != itemRegistry.end(); ++it) {
+        for (QGraphicsItem* child : it->second->childItems()) {
+            EditableTextItem* text = dynamic_cast<EditableTextItem*>(child);
+            if (text) {
+                text->onFontChanged(font);
+            }
+        }
+    }
+    update();
+}
+
 void CyberiadaSMEditorScene::slotGridSettingsChanged()
 {
+    slotBackgroundChanged();
+}
+
+void CyberiadaSMEditorScene::slotBackgroundChanged()
+{
+    // the views cache the background (the frame & the grid)
+    for (QGraphicsView* view : views()) {
+        view->resetCachedContent();
+    }
     update();
 }
 
@@ -224,92 +729,97 @@ void CyberiadaSMEditorScene::addItemsRecursively(QGraphicsItem* parent, Cyberiad
 {
 	Cyberiada::ElementType parent_type = collection->get_type();
     QGraphicsItem* new_parent = parent;
-    qDebug() << "parent=null" <<  (new_parent == NULL);
+    EDITOR_DEBUG(lcEditorScene) << "parent=null" <<  (new_parent == NULL);
 
     if (parent_type == Cyberiada::elementSM) {
         new_parent = new CyberiadaSMEditorSMItem(model, collection, parent);
-        elementIdToItemMap.insert(collection->get_id(), new_parent);
+        itemRegistry.insert(collection->get_id(), new_parent);
         addItem(new_parent);
         new_parent->setSelected(true);
     }
 
-    qDebug() << "PARENT: " << collection->get_id().c_str();
+    EDITOR_DEBUG(lcEditorScene) << "PARENT: " << collection->get_id().c_str();
     if (collection->has_children()) {
 		const Cyberiada::ElementList& children = collection->get_children();
 		for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
-			Cyberiada::Element* child = *i;
-            Cyberiada::ElementType type = child->get_type();
-
-			switch(type) {
-            case Cyberiada::elementCompositeState: {
-                CyberiadaSMEditorStateItem* state = new CyberiadaSMEditorStateItem(this, model, child, new_parent);
-                elementIdToItemMap.insert(child->get_id(), state);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-                addItemsRecursively(state->getRegion(), static_cast<Cyberiada::ElementCollection*>(child));
-                addItem(state);
-                break;
-            }
-            case Cyberiada::elementSimpleState: {
-                CyberiadaSMEditorStateItem* state = new CyberiadaSMEditorStateItem(this, model, child, new_parent);
-                elementIdToItemMap.insert(child->get_id(), state);
-                addItem(state);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-				break;
-            }
-            case Cyberiada::elementInitial: {
-                CyberiadaSMEditorVertexItem* initial = new CyberiadaSMEditorVertexItem(model, child, new_parent);
-                elementIdToItemMap.insert(child->get_id(), initial);
-                addItem(initial);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-                break;
-            }
-            case Cyberiada::elementFinal: {
-                CyberiadaSMEditorVertexItem* final = new CyberiadaSMEditorVertexItem(model, child, new_parent);
-                elementIdToItemMap.insert(child->get_id(), final);
-                addItem(final);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-                break;
-            }
-            case Cyberiada::elementTerminate: {
-                CyberiadaSMEditorVertexItem* terminate = new CyberiadaSMEditorVertexItem(model, child, new_parent);
-                elementIdToItemMap.insert(child->get_id(), terminate);
-                addItem(terminate);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-                break;
-            }
-			case Cyberiada::elementChoice:
-                // new CyberiadaSMEditorChoiceItem(model, child, new_parent);
-				break;
-            case Cyberiada::elementComment: {
-                if (!child->has_geometry()) break;
-                CyberiadaSMEditorCommentItem* comment = new CyberiadaSMEditorCommentItem(this, model, child, new_parent, elementIdToItemMap);
-                elementIdToItemMap.insert(child->get_id(), comment);
-                addItem(comment);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-                break;
-            }
-            case Cyberiada::elementFormalComment: {
-                if (!child->has_geometry()) break;
-                CyberiadaSMEditorCommentItem* formalComment = new CyberiadaSMEditorCommentItem(this, model, child, new_parent, elementIdToItemMap);
-                elementIdToItemMap.insert(child->get_id(), formalComment);
-                addItem(formalComment);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-                break;
-            }
-            case Cyberiada::elementTransition: {
-                CyberiadaSMEditorTransitionItem* transition = new CyberiadaSMEditorTransitionItem(this, model, child, NULL, elementIdToItemMap);
-                elementIdToItemMap.insert(child->get_id(), transition);
-                addItem(transition);
-                qDebug() << "add item" << child->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(new_parent).c_str() << model->elementToIndex(child);
-                break;
-            }
-			default:
-				MY_ASSERT(false);
-			}
+            addElementItem(new_parent, *i);
 		}
     }
 }
 
+QGraphicsItem* CyberiadaSMEditorScene::addElementItem(QGraphicsItem* parent, Cyberiada::Element* child)
+{
+    Cyberiada::ElementType type = child->get_type();
+
+    switch(type) {
+    case Cyberiada::elementCompositeState: {
+        CyberiadaSMEditorStateItem* state = new CyberiadaSMEditorStateItem(this, model, child, parent);
+        itemRegistry.insert(child->get_id(), state);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        addItemsRecursively(state->getRegion(), static_cast<Cyberiada::ElementCollection*>(child));
+        addItem(state);
+        return state;
+    }
+    case Cyberiada::elementSimpleState: {
+        CyberiadaSMEditorStateItem* state = new CyberiadaSMEditorStateItem(this, model, child, parent);
+        itemRegistry.insert(child->get_id(), state);
+        addItem(state);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        return state;
+    }
+    case Cyberiada::elementInitial: {
+        CyberiadaSMEditorVertexItem* initial = new CyberiadaSMEditorVertexItem(model, child, parent);
+        itemRegistry.insert(child->get_id(), initial);
+        addItem(initial);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        return initial;
+    }
+    case Cyberiada::elementFinal: {
+        CyberiadaSMEditorVertexItem* final = new CyberiadaSMEditorVertexItem(model, child, parent);
+        itemRegistry.insert(child->get_id(), final);
+        addItem(final);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        return final;
+    }
+    case Cyberiada::elementTerminate: {
+        CyberiadaSMEditorVertexItem* terminate = new CyberiadaSMEditorVertexItem(model, child, parent);
+        itemRegistry.insert(child->get_id(), terminate);
+        addItem(terminate);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        return terminate;
+    }
+    case Cyberiada::elementChoice:
+        // new CyberiadaSMEditorChoiceItem(model, child, parent);
+        return NULL;
+    case Cyberiada::elementComment: {
+        if (!child->has_geometry()) return NULL;
+        CyberiadaSMEditorCommentItem* comment = new CyberiadaSMEditorCommentItem(this, model, child, parent, itemRegistry);
+        itemRegistry.insert(child->get_id(), comment);
+        addItem(comment);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        return comment;
+    }
+    case Cyberiada::elementFormalComment: {
+        if (!child->has_geometry()) return NULL;
+        CyberiadaSMEditorCommentItem* formalComment = new CyberiadaSMEditorCommentItem(this, model, child, parent, itemRegistry);
+        itemRegistry.insert(child->get_id(), formalComment);
+        addItem(formalComment);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        return formalComment;
+    }
+    case Cyberiada::elementTransition: {
+        CyberiadaSMEditorTransitionItem* transition = new CyberiadaSMEditorTransitionItem(this, model, child, NULL, itemRegistry);
+        itemRegistry.insert(child->get_id(), transition);
+        addItem(transition);
+        EDITOR_DEBUG(lcEditorScene) << "add item" << child->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parent).c_str() << model->elementToIndex(child);
+        return transition;
+    }
+    default:
+        MY_ASSERT(false);
+    }
+    return NULL;
+}
+
 // void CyberiadaSMEditorScene::setGridSize(int newSize)
 // {
 //     if (newSize > 0) {
@@ -332,29 +842,64 @@ void CyberiadaSMEditorScene::addItemsRecursively(QGraphicsItem* parent, Cyberiad
 void CyberiadaSMEditorScene::setGridPen(const QPen &pen)
 {
     gridPen = pen;
-    update();
+    slotBackgroundChanged();
 }
 
 void CyberiadaSMEditorScene::loadScene()
 {
-    elementIdToItemMap.clear();
+    // the rebuilt scene (undo/redo, edit scripts) keeps showing the same machine
+    Cyberiada::StateMachine* sm = NULL;
+    if (!currentSMId.empty()) {
+        sm = dynamic_cast<Cyberiada::StateMachine*>(model->idToElement(QString(currentSMId.c_str())));
+    }
+    if (sm == NULL) {
+        sm = static_cast<Cyberiada::StateMachine*>(model->indexToElement(model->firstSMIndex()));
+    }
+    showStateMachine(sm);
+}
+
+void CyberiadaSMEditorScene::showStateMachine(Cyberiada::StateMachine* sm)
+{
+    MY_ASSERT(sm);
+
+    // only one machine has items at a time: the previous one is released
+    itemRegistry.clear();
 
     clear();
 
-    MY_ASSERT(elementIdToItemMap.isEmpty());
+    MY_ASSERT(itemRegistry.isEmpty());
     MY_ASSERT(items().isEmpty());
 
-    Cyberiada::StateMachine* sm = static_cast<Cyberiada::StateMachine*>(model->indexToElement(model->firstSMIndex()));
+    // the new items are built from the current model
+    discardPendingSync();
     currentSM = sm;
+    currentSMId = sm->get_id();
+    spatialIndexDirty = true;
     addItemsRecursively(NULL, sm);
-    for (auto item : items()) {
-        if (auto smItem = dynamic_cast<CyberiadaSMEditorSMItem*>(item)) {
-            connect(smItem, &CyberiadaSMEditorAbstractItem::sizeChanged, this, &CyberiadaSMEditorScene::slotSMSizeChanged);
-            break;
+    // the transition paths cached while the vertices were still being built
+    for (auto it = itemRegistry.begin(); it != itemRegistry.end(); ++it) {
+        if (it->second->type() == CyberiadaSMEditorAbstractItem::TransitionItem) {
+            static_cast<CyberiadaSMEditorTransitionItem*>(it->second)->invalidatePath();
         }
     }
+    QGraphicsItem* smItem = itemRegistry.item(currentSMId);
+    if (smItem) {
+        connect(static_cast<CyberiadaSMEditorSMItem*>(smItem), &CyberiadaSMEditorAbstractItem::sizeChanged,
+                this, &CyberiadaSMEditorScene::slotSMSizeChanged);
+    }
     // qreal margin = std::max(itemsBoundingRect().width(), itemsBoundingRect().height()) * DEFAULT_SCENE_BORDER_MARGIN_PERCENT;
     qreal margin = DEFAULT_SCENE_BORDER_MARGIN;
+    contentRect = visibleItemsRect();
+    contentShrinkPending = false;
+    setSceneRect(contentRect.adjusted(-margin, -margin, margin, margin));
+    EDITOR_DEBUG(lcEditorScene) << "new scene rect" << sceneRect();
+    // views().first()->fitInView(itemsBoundingRect(), Qt::KeepAspectRatio);
+    views().first()->fitInView(sceneRect(), Qt::KeepAspectRatio);
+    update();
+}
+
+QRectF CyberiadaSMEditorScene::visibleItemsRect() const
+{
     // itemsBoundingRect() ignores visibility - union the visible items only,
     // so hidden elements (text in the no-text mode, dots) do not leak into
     // the scene rect
@@ -364,11 +909,95 @@ void CyberiadaSMEditorScene::loadScene()
             bounds |= item->sceneBoundingRect();
         }
     }
-    setSceneRect(bounds.adjusted(-margin, -margin, margin, margin));
-    qDebug() << "new scene rect" << sceneRect();
-    // views().first()->fitInView(itemsBoundingRect(), Qt::KeepAspectRatio);
-    views().first()->fitInView(sceneRect(), Qt::KeepAspectRatio);
-    update();
+    return bounds;
+}
+
+void CyberiadaSMEditorScene::updateContentRect(const QRectF& old_bounds, const QRectF& new_bounds)
+{
+    if (!contentRect.contains(new_bounds)) {
+        // growing needs the changed item only
+        contentRect |= new_bounds;
+        qreal margin = DEFAULT_SCENE_BORDER_MARGIN;
+        setSceneRect(contentRect.adjusted(-margin, -margin, margin, margin));
+    } else if (old_bounds != new_bounds &&
+               (old_bounds.left() <= contentRect.left() || old_bounds.top() <= contentRect.top() ||
+                old_bounds.right() >= contentRect.right() || old_bounds.bottom() >= contentRect.bottom())) {
+        // an item has left the border: the content may have shrunk, it is
+        // recomputed when asked for
+        contentShrinkPending = true;
+    }
+}
+
+QRectF CyberiadaSMEditorScene::contentBoundingRect()
+{
+    // the queued changes are a part of the content
+    slotFlushSync();
+    if (contentShrinkPending) {
+        contentRect = visibleItemsRect();
+        contentShrinkPending = false;
+        qreal margin = DEFAULT_SCENE_BORDER_MARGIN;
+        setSceneRect(contentRect.adjusted(-margin, -margin, margin, margin));
+    }
+    return contentRect;
+}
+
+void CyberiadaSMEditorScene::ensureSpatialIndex()
+{
+    // the queries see the items at their model places
+    slotFlushSync();
+    if (!spatialIndexDirty) {
+        return;
+    }
+    // the structure has changed (the scene is rebuilt, the items are added
+    // or deleted): index the top-level items with their subtrees once
+    spatialIndex.clear();
+    for (auto it = itemRegistry.begin(); it != itemRegistry.end(); ++it) {
+        if (it->second->parentItem() == NULL) {
+            indexItems(it->second, 0);
+        }
+    }
+    spatialIndexDirty = false;
+}
+
+void CyberiadaSMEditorScene::indexItems(QGraphicsItem* item, int depth)
+{
+    int childDepth = depth;
+    switch (item->type()) {
+    case CyberiadaSMEditorAbstractItem::SMItem:
+    case CyberiadaSMEditorAbstractItem::StateItem:
+    case CyberiadaSMEditorAbstractItem::CompositeStateItem:
+        spatialIndex.insert(item, item->sceneBoundingRect(), depth, CyberiadaSMEditorSpatialIndex::Container);
+        childDepth++;
+        break;
+    case CyberiadaSMEditorAbstractItem::VertexItem:
+        spatialIndex.insert(item, item->sceneBoundingRect(), depth, CyberiadaSMEditorSpatialIndex::Vertex);
+        childDepth++;
+        break;
+    case CyberiadaSMEditorAbstractItem::TransitionItem:
+    case CyberiadaSMEditorAbstractItem::CommentItem:
+        return;
+    default:
+        // the state regions hold the nested states
+        break;
+    }
+    for (QGraphicsItem* child : item->childItems()) {
+        indexItems(child, childDepth);
+    }
+}
+
+CyberiadaSMEditorAbstractItem* CyberiadaSMEditorScene::containerAt(const QPointF& point, const QGraphicsItem* exclude)
+{
+    ensureSpatialIndex();
+    return static_cast<CyberiadaSMEditorAbstractItem*>(
+        spatialIndex.itemAt(point, CyberiadaSMEditorSpatialIndex::Container, 0, exclude));
+}
+
+CyberiadaSMEditorAbstractItem* CyberiadaSMEditorScene::connectableAt(const QPointF& point)
+{
+    ensureSpatialIndex();
+    // the state machine itself (depth 0) is not a transition end
+    return static_cast<CyberiadaSMEditorAbstractItem*>(
+        spatialIndex.itemAt(point, CyberiadaSMEditorSpatialIndex::Container | CyberiadaSMEditorSpatialIndex::Vertex, 1));
 }
 
 void CyberiadaSMEditorScene::setCurrentTool(ToolType tool) {
@@ -395,14 +1024,11 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     }
     if (parentCItem == nullptr) {
         if (currentSM == nullptr) {
+            // the new machine is shown by slotElementInserted()
             Cyberiada::Element* element = model->newStateMachine("New State Machine");
-            currentSM = static_cast<Cyberiada::StateMachine*>(element);
-            CyberiadaSMEditorSMItem* sm = new CyberiadaSMEditorSMItem(model, element, nullptr);
-            parentCItem = sm;
+            parentCItem = dynamic_cast<CyberiadaSMEditorAbstractItem*>(itemRegistry.item(element->get_id()));
             parentColl = static_cast<Cyberiada::ElementCollection*>(element);
-            elementIdToItemMap.insert(element->get_id(), sm);
-            addItem(sm);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type;
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type;
         } else {
             for (auto item : items()) {
                 if (auto smItem = dynamic_cast<CyberiadaSMEditorSMItem*>(item)) {
@@ -416,7 +1042,7 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
 
     Cyberiada::LocalDocument* d = model->rootDocument();
     if (d == NULL) {
-        qDebug() << "LocalDocument NULL";
+        EDITOR_DEBUG(lcEditorScene) << "LocalDocument NULL";
         // TODO create doc
     }
 
@@ -427,16 +1053,16 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
         center = sceneRect().center();
     }
 
+    // the items of the new elements are built by slotElementInserted()
     switch(type) {
     case Cyberiada::elementSM: {
         try {
             Cyberiada::Element* element = model->newStateMachine("New State Machine", Cyberiada::Rect(sceneRect().center().x(), sceneRect().center().y(), 200, 100));
-            currentSM = static_cast<Cyberiada::StateMachine*>(element);
-            CyberiadaSMEditorSMItem* sm = new CyberiadaSMEditorSMItem(model, element, nullptr);
-            elementIdToItemMap.insert(element->get_id(), sm);
-            addItem(sm);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type;
-            sm->setSelected(true);
+            // a new machine is shown alone, like any other one
+            if (element != currentSM) {
+                showStateMachine(static_cast<Cyberiada::StateMachine*>(element));
+            }
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type;
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new state"),
@@ -450,11 +1076,8 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
         try {
             Cyberiada::Element* element = model->newState(parentColl, "New state", Cyberiada::Action(),
                                                           Cyberiada::Rect(center.x(), center.y(), 200, 100));
-            CyberiadaSMEditorStateItem* state = new CyberiadaSMEditorStateItem(this, model, element, parentCItem);
-            elementIdToItemMap.insert(element->get_id(), state);
-            addItem(state);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(parentCItem).c_str();
-            state->setSelected(true);
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parentCItem).c_str();
+            selectElementItem(element);
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new state"),
@@ -470,11 +1093,8 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     case Cyberiada::elementInitial: {
         try {
             Cyberiada::Element* element = model->newInitial(parentColl, Cyberiada::Point(center.x(), center.y()));
-            CyberiadaSMEditorVertexItem* initial = new CyberiadaSMEditorVertexItem(model, element, parentCItem);
-            elementIdToItemMap.insert(element->get_id(), initial);
-            addItem(initial);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(parentCItem).c_str();
-            initial->setSelected(true);
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parentCItem).c_str();
+            selectElementItem(element);
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new initial"),
@@ -486,11 +1106,8 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     case Cyberiada::elementFinal: {
         try {
             Cyberiada::Element* element = model->newFinal(parentColl, Cyberiada::Point(center.x(), center.y()));
-            CyberiadaSMEditorVertexItem* final = new CyberiadaSMEditorVertexItem(model, element, parentCItem);
-            elementIdToItemMap.insert(element->get_id(), final);
-            addItem(final);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(parentCItem).c_str();
-            final->setSelected(true);
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parentCItem).c_str();
+            selectElementItem(element);
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new final"),
@@ -502,11 +1119,8 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     case Cyberiada::elementTerminate: {
         try {
             Cyberiada::Element* element = model->newTerminate(parentColl, Cyberiada::Point(center.x(), center.y()));
-            CyberiadaSMEditorVertexItem* terminate = new CyberiadaSMEditorVertexItem(model, element, parentCItem);
-            elementIdToItemMap.insert(element->get_id(), terminate);
-            addItem(terminate);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(parentCItem).c_str();
-            terminate->setSelected(true);
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parentCItem).c_str();
+            selectElementItem(element);
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new terminate"),
@@ -521,11 +1135,8 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     case Cyberiada::elementComment: {
         try {
             Cyberiada::Element* element = model->newComment(parentColl, "New comment", Cyberiada::Rect(center.x(), center.y(), 200, 100));
-            CyberiadaSMEditorCommentItem* comment = new CyberiadaSMEditorCommentItem(this, model, element, parentCItem, elementIdToItemMap);
-            elementIdToItemMap.insert(element->get_id(), comment);
-            addItem(comment);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(parentCItem).c_str();
-            comment->setSelected(true);
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parentCItem).c_str();
+            selectElementItem(element);
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new comment"),
@@ -537,11 +1148,8 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     case Cyberiada::elementFormalComment: {
         try {
             Cyberiada::Element* element = model->newFormalComment(parentColl, "New formal comment", Cyberiada::Rect(center.x(), center.y(), 200, 100));
-            CyberiadaSMEditorCommentItem* formalComment = new CyberiadaSMEditorCommentItem(this, model, element, parentCItem, elementIdToItemMap);
-            elementIdToItemMap.insert(element->get_id(), formalComment);
-            addItem(formalComment);
-            qDebug() << "add item" << element->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(parentCItem).c_str();
-            formalComment->setSelected(true);
+            EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parentCItem).c_str();
+            selectElementItem(element);
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new formal comment"),
@@ -553,10 +1161,10 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     case Cyberiada::elementTransition: {
         try {
             // Cyberiada::Element* element = d->new_transition(currentSM, "New state", Cyberiada::Point(center.x(), center.y()));
-            // CyberiadaSMEditorTransitionItem* transition = new CyberiadaSMEditorTransitionItem(this, model, element, settings, NULL, elementIdToItemMap);
-            // elementIdToItemMap.insert(element->get_id(), transition);
+            // CyberiadaSMEditorTransitionItem* transition = new CyberiadaSMEditorTransitionItem(this, model, element, settings, NULL, itemRegistry);
+            // itemRegistry.insert(element->get_id(), transition);
             // addItem(transition);
-            // qDebug() << "add item" << element->get_id().c_str() << "type" << type << "parent" << elementIdToItemMap.key(parentCItem).c_str();
+            // EDITOR_DEBUG(lcEditorScene) << "add item" << element->get_id().c_str() << "type" << type << "parent" << itemRegistry.id(parentCItem).c_str();
             break;
         } catch (const Cyberiada::ParametersException& e){
             QMessageBox::critical(NULL, tr("Create new transition"),
@@ -571,6 +1179,14 @@ void CyberiadaSMEditorScene::addSMItem(Cyberiada::ElementType type)
     }
 }
 
+void CyberiadaSMEditorScene::selectElementItem(Cyberiada::Element* element)
+{
+    QGraphicsItem* item = itemRegistry.item(element->get_id());
+    if (item) {
+        item->setSelected(true);
+    }
+}
+
 CyberiadaSMEditorTransitionItem* CyberiadaSMEditorScene::addTransition(CyberiadaSMEditorAbstractItem *source,
                                            CyberiadaSMEditorAbstractItem *target)
 {
@@ -578,12 +1194,8 @@ CyberiadaSMEditorTransitionItem* CyberiadaSMEditorScene::addTransition(Cyberiada
         Cyberiada::Element* element = model->newTransition(currentSM, Cyberiada::transitionExternal,
                                                         source->getElement(), target->getElement(),
                                                         Cyberiada::Action(Cyberiada::actionTransition));
-        CyberiadaSMEditorTransitionItem* transition = new CyberiadaSMEditorTransitionItem(
-            this, model, element, NULL, elementIdToItemMap);
-        elementIdToItemMap.insert(element->get_id(), transition);
-        addItem(transition);
-        transition->setSelected(true);
-        return transition;
+        selectElementItem(element);
+        return dynamic_cast<CyberiadaSMEditorTransitionItem*>(itemRegistry.item(element->get_id()));
     } catch (const Cyberiada::ParametersException& e){
         QMessageBox::critical(NULL, tr("Create new transition"),
                               tr("Parameters error:\n") + QString(e.str().c_str()));
@@ -592,7 +1204,7 @@ CyberiadaSMEditorTransitionItem* CyberiadaSMEditorScene::addTransition(Cyberiada
     }
 }
 
-void CyberiadaSMEditorScene::drawBackground(QPainter* painter, const QRectF &)
+void CyberiadaSMEditorScene::drawBackground(QPainter* painter, const QRectF& exposed)
 {
     SettingsManager& sm = SettingsManager::instance();
 
@@ -610,20 +1222,42 @@ void CyberiadaSMEditorScene::drawBackground(QPainter* painter, const QRectF &)
 		return ;
 	}
 
-	painter->setPen(gridPen);
-
 	QRectF rect = sceneRect();
+    qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    if (scale <= 0) {
+        return ;
+    }
+    // the lines crossing the exposed area only (with a pixel margin for the
+    // antialiased ones on the edge)
+    qreal margin = 1.0 / scale;
+    QRectF area = exposed.adjusted(-margin, -margin, margin, margin) & rect.adjusted(-margin, -margin, margin, margin);
+    if (area.isEmpty()) {
+        return ;
+    }
+
+	painter->setPen(gridPen);
 
     int gridSize = sm.getGridSpacing();
+    // zoomed out: every second line is skipped until the grid is sparse enough
+    int step = gridSize;
+    while (step * scale < GRID_MIN_SPACING_PIXELS) {
+        step *= 2;
+    }
 
 	double left = int(rect.left()) - (int(rect.left()) % gridSize);
 	double top = int(rect.top()) - (int(rect.top()) % gridSize);
+    // the lines keep the full scene length, so the dot pattern does not
+    // depend on the exposed area
+    double first_x = left + std::max(0.0, std::ceil((area.left() - left) / step)) * step;
+    double first_y = top + std::max(0.0, std::ceil((area.top() - top) / step)) * step;
+    double last_x = std::min(area.right(), rect.right());
+    double last_y = std::min(area.bottom(), rect.bottom());
 
 	QVarLengthArray<QLineF, 100> lines;
 
-	for (double x = left; x < rect.right(); x += gridSize)
+	for (double x = first_x; x < rect.right() && x <= last_x; x += step)
 		lines.append(QLineF(x, rect.top(), x, rect.bottom()));
-	for (double y = top; y < rect.bottom(); y += gridSize)
+	for (double y = first_y; y < rect.bottom() && y <= last_y; y += step)
 		lines.append(QLineF(rect.left(), y, rect.right(), y));
 
 	painter->drawLines(lines.data(), lines.size());
@@ -34,11 +34,15 @@
 #include <QByteArrayList>
 #include <QList>
 #include <QGraphicsItem>
+#include <QGraphicsSceneMouseEvent>
+#include <QTimer>
 #include <QDebug>
 #include <string>
 
 #include "cyberiadasm_model.h"
 #include "cyberiadasm_editor_items.h"
+#include "cyberiadasm_editor_registry.h"
+#include "cyberiadasm_editor_spatial_index.h"
 #include "cyberiadasm_editor_state_item.h"
 #include "cyberiadasm_editor_transition_item.h"
 #include "cyberiada_constants.h"
@@ -61,9 +65,22 @@ public:
     void  setGridPen(const QPen& gridPen);
     const QPen& getGridPen() const { return gridPen; }
 
+    // builds the items of the shown state machine (the first one by default)
     void  loadScene();
+    // releases the items of the shown machine and builds the given one
+    void  showStateMachine(Cyberiada::StateMachine* sm);
+    Cyberiada::StateMachine* getCurrentSM() const { return currentSM; }
+    // the union of the visible items, maintained on the model updates
+    QRectF contentBoundingRect();
 
-    QMap<Cyberiada::ID, QGraphicsItem*>& getMap() { return elementIdToItemMap; }
+    CyberiadaSMEditorItemRegistry& getRegistry() { return itemRegistry; }
+    // the settings snapshot the items paint with
+    const CyberiadaSMEditorStyle& getStyle() const { return style; }
+
+    // the innermost state (or the state machine) under the scene point
+    CyberiadaSMEditorAbstractItem* containerAt(const QPointF& point, const QGraphicsItem* exclude = NULL);
+    // the innermost state or vertex under the scene point (transition ends)
+    CyberiadaSMEditorAbstractItem* connectableAt(const QPointF& point);
 
     void  setCurrentTool(ToolType tool);
     ToolType getCurrentTool() { return currentTool; }
@@ -76,24 +93,79 @@ public:
 public slots:
 	void  slotElementSelected(const QModelIndex& index);
     void  slotModelDataChanged(const QModelIndex & topLeft, const QModelIndex & bottomRight);
+    void  slotModelAboutToBeReset();
+    // the structure changes: only the items of the affected subtree are built,
+    // released or reparented
+    void  slotElementInserted(Cyberiada::Element* element);
+    void  slotElementAboutToBeRemoved(Cyberiada::Element* element);
+    void  slotElementMoved(Cyberiada::Element* element);
+    void  slotElementIdChanged(const QString& old_id, const QString& new_id);
     void  slotSMSizeChanged(CyberiadaSMEditorAbstractItem::CornerFlags side, qreal d);
 	
     // void  enableGrid(bool on = true);
     // void  enableGridSnap(bool on = true);
     void  slotGridSettingsChanged();
+    void  slotBackgroundChanged();
     void  slotSelectionChanged();
+    void  slotFlushDrag();
+    // syncs the items of the queued model changes, parents first
+    void  slotFlushSync();
+    // the settings are received once by the scene and passed to the items
+    void  slotInspectorModeChanged(bool on);
+    void  slotSelectionSettingsChanged();
+    void  slotShowTransitionTextChanged(bool on);
+    void  slotFontChanged(const QFont& font);
 
 protected:
-    void  drawBackground(QPainter *painter, const QRectF &);
+    void  drawBackground(QPainter *painter, const QRectF &exposed);
+    void  mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
+    void  mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
 private:
     void  addItemsRecursively(QGraphicsItem* parent, Cyberiada::ElementCollection* element);
+    QGraphicsItem* addElementItem(QGraphicsItem* parent, Cyberiada::Element* element);
+    QGraphicsItem* containerItem(Cyberiada::Element* element);
+    void  removeElementItems(Cyberiada::Element* element);
+    void  releaseItemsRecursively(Cyberiada::Element* element);
+    void  stackInDocumentOrder(QGraphicsItem* item, Cyberiada::Element* element);
+    void  invalidateTransitions(Cyberiada::Element* element);
+    void  syncMachineItem();
+    bool  isShown(Cyberiada::Element* element) const;
+    void  selectElementItem(Cyberiada::Element* element);
     void  updateItemsRecursively(CyberiadaSMEditorAbstractItem* parent, Cyberiada::ElementCollection* element);
+    QRectF visibleItemsRect() const;
+    void  updateContentRect(const QRectF& old_bounds, const QRectF& new_bounds);
+    void  ensureSpatialIndex();
+    void  updateStyle();
+    void  dispatchMouseMove(QGraphicsSceneMouseEvent* event);
+    void  discardPendingDrag();
+    void  queueSync(Cyberiada::Element* element);
+    void  unqueueSync(Cyberiada::Element* element);
+    void  discardPendingSync();
+    bool  syncElement(Cyberiada::Element* element);
+    void  indexItems(QGraphicsItem* item, int depth);
 
 
     CyberiadaSMModel*              model;
 	Cyberiada::StateMachine*       currentSM;
-    QMap<Cyberiada::ID, QGraphicsItem*> elementIdToItemMap;
+    Cyberiada::ID                  currentSMId;
+    QRectF                         contentRect;
+    bool                           contentShrinkPending;
+    CyberiadaSMEditorItemRegistry  itemRegistry;
+    CyberiadaSMEditorStyle         style;
+    CyberiadaSMEditorSpatialIndex  spatialIndex;
+    bool                           spatialIndexDirty;
+    // the latest drag move not yet delivered to the grabber item
+    QGraphicsSceneMouseEvent*      pendingMove;
+    QTimer                         dragTimer;
+    // the changed elements waiting for the item sync, in the order of their
+    // first change; the model is never written while they are synced
+    QList<Cyberiada::Element*>     syncQueue;
+    QSet<Cyberiada::Element*>      syncQueued;
+    QTimer                         syncTimer;
+    bool                           syncing;
+    // the selection is being set from the tree, not by the user
+    bool                           selectionGuard;
 	
     // int                            gridSize;
     // bool                           gridEnabled;
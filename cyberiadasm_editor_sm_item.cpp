@@ -24,6 +24,7 @@
 #include <QDebug>
 #include <QPainter>
 #include <QColor>
+#include <QStyleOptionGraphicsItem>
 #include "cyberiadasm_editor_sm_item.h"
 #include "myassert.h"
 #include "settings_manager.h"
@@ -32,17 +33,25 @@
  * State Machine Item
  * ----------------------------------------------------------------------------- */
 
+// the name frame in the top left corner of the machine
+static const qreal SM_NAME_FRAME_WIDTH = 50;
+static const qreal SM_NAME_FRAME_HEIGHT = 30;
+// the cut of the bottom right corner of the name frame
+static const qreal SM_NAME_FRAME_CORNER = 10;
+
 CyberiadaSMEditorSMItem::CyberiadaSMEditorSMItem(CyberiadaSMModel* model,
                                                  Cyberiada::Element* element,
                                                  QGraphicsItem* parent):
     CyberiadaSMEditorAbstractItem(model, element, parent)
 {
-    QRectF rect = toQtRect(element->get_bound_rect(*(model->rootDocument())));
+    QRectF rect = toQtRect(model->elementBoundRect(element));
+    refreshGeometry();
 
     if(element->has_geometry()) {
         setPos(rect.x(), rect.y());
     }
-    setFlags(ItemIsSelectable);
+    // the frame is painted only where exposed
+    setFlags(ItemIsSelectable | ItemUsesExtendedStyleOption);
 
     isHighlighted = false;
 
@@ -52,50 +61,86 @@ CyberiadaSMEditorSMItem::CyberiadaSMEditorSMItem(CyberiadaSMModel* model,
 }
 
 QRectF CyberiadaSMEditorSMItem::boundingRect() const
+{
+    return bounds;
+}
+
+void CyberiadaSMEditorSMItem::refreshGeometry()
 {
     MY_ASSERT(model);
     MY_ASSERT(model->rootDocument());
     MY_ASSERT(element);
 
-    Cyberiada::Rect r = element->get_bound_rect(*(model->rootDocument()));
+    Cyberiada::Rect r = model->elementBoundRect(element);
     QRectF rect = toQtRect(r);
 
+    QRectF newBounds;
     if(!element->has_geometry()) {
-        return QRectF(rect.x() - rect.width() / 2, rect.y() - rect.height() / 2, rect.width(), rect.height());
+        newBounds = QRectF(rect.x() - rect.width() / 2, rect.y() - rect.height() / 2, rect.width(), rect.height());
+    } else {
+        newBounds = QRectF(- rect.width() / 2, - rect.height() / 2, rect.width(), rect.height());
+    }
+    // the machine spans the whole diagram: a change inside it that keeps
+    // the bounds does not repaint it
+    if (newBounds != bounds) {
+        prepareGeometryChange();
+        bounds = newBounds;
     }
-    return QRectF(- rect.width() / 2, - rect.height() / 2, rect.width(), rect.height());
 }
 
-
-void CyberiadaSMEditorSMItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
+void CyberiadaSMEditorSMItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
 {
     if (!element->has_geometry()) return;
 
     QPen pen = QPen(Qt::black, 2, Qt::SolidLine);
+    QRectF r = boundingRect();
     if (isSelected() || isHighlighted) {
-        SettingsManager& sm = SettingsManager::instance();
-        pen.setColor(sm.getSelectionColor());
-        pen.setWidth(sm.getSelectionBorderWidth());
-        QColor fillColor = sm.getSelectionColor();
+        const CyberiadaSMEditorStyle& st = style();
+        pen.setColor(st.selectionColor);
+        pen.setWidth(st.selectionBorderWidth);
+        QColor fillColor = st.selectionColor;
         fillColor.setAlpha(50);
         painter->setBrush(QBrush(fillColor));
     }
+    QPolygonF name_frame = nameFrame(r);
+    qreal margin = pen.widthF() + 1;
+    if (!isSelected() && !isHighlighted &&
+        !isFrameExposed(r, pen.widthF(), option->exposedRect) &&
+        !name_frame.boundingRect().adjusted(-margin, -margin, margin, margin).intersects(option->exposedRect)) {
+        // an edit inside the machine exposes its interior only
+        return;
+    }
 
     painter->setPen(pen);
-    QRectF r = boundingRect();
     painter->drawRect(r);
-    const QPointF name_frame[] = {
-        QPointF(r.left(), r.top()),
-        QPointF(r.left() + 50, r.top()),
-        QPointF(r.left() + 50, r.top() + 20),
-        QPointF(r.left() + 40, r.top() + 30),
-        QPointF(r.left(), r.top() + 30)
-    };
-    painter->drawConvexPolygon(name_frame, 5);
+    painter->drawConvexPolygon(name_frame);
 }
 
+QPolygonF CyberiadaSMEditorSMItem::nameFrame(const QRectF& r)
+{
+    QPolygonF frame;
+    frame << QPointF(r.left(), r.top())
+          << QPointF(r.left() + SM_NAME_FRAME_WIDTH, r.top())
+          << QPointF(r.left() + SM_NAME_FRAME_WIDTH, r.top() + SM_NAME_FRAME_HEIGHT - SM_NAME_FRAME_CORNER)
+          << QPointF(r.left() + SM_NAME_FRAME_WIDTH - SM_NAME_FRAME_CORNER, r.top() + SM_NAME_FRAME_HEIGHT)
+          << QPointF(r.left(), r.top() + SM_NAME_FRAME_HEIGHT);
+    return frame;
+}
 
 
+void CyberiadaSMEditorSMItem::syncFromModel()
+{
+    // the machine covers the whole diagram, with all the items inside: it is
+    // repainted only when its frame changes (prepareGeometryChange() in
+    // refreshGeometry(), setPos()), never by the update() of the base class
+    refreshGeometry();
+    if (element->has_geometry()) {
+        QRectF rect = toQtRect(model->elementBoundRect(element));
+        setPos(rect.x(), rect.y());
+    }
+    setDotsPosition();
+}
+
 void CyberiadaSMEditorSMItem::updateSizeToFitChildren(CyberiadaSMEditorAbstractItem *child)
 {
     // TODO copy from state
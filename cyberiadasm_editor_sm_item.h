@@ -45,8 +45,19 @@ public:
 
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
 
+    // the machine bounds follow its children
+    void syncFromModel() override;
+
+protected:
+    void refreshGeometry() override;
+
 private:
     void updateSizeToFitChildren(CyberiadaSMEditorAbstractItem* child) override;
+    // the outline of the name frame, both painted and tested for exposure
+    static QPolygonF nameFrame(const QRectF& r);
+
+    // the bounds of the machine content, refreshed by syncFromModel()
+    QRectF bounds;
 };
 
 
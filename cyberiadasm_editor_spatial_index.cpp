@@ -0,0 +1,199 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ * 
+ * The State Machine Editor Spatial Index
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#include <cmath>
+
+#include "cyberiadasm_editor_spatial_index.h"
+#include "myassert.h"
+
+// the cells of the finest level
+static const qreal SPATIAL_INDEX_CELL_SIZE = 256;
+// the cell size grows by this factor on every level up
+static const int SPATIAL_INDEX_LEVEL_FACTOR = 4;
+// the coarsest cells (256 * 4^11 px) are larger than any diagram
+static const int SPATIAL_INDEX_MAX_LEVELS = 12;
+
+CyberiadaSMEditorSpatialIndex::CyberiadaSMEditorSpatialIndex():
+    nextOrder(0)
+{
+}
+
+quint64 CyberiadaSMEditorSpatialIndex::cellKey(int col, int row)
+{
+    return (quint64(quint32(col)) << 32) | quint32(row);
+}
+
+qreal CyberiadaSMEditorSpatialIndex::cellSize(int level)
+{
+    qreal size = SPATIAL_INDEX_CELL_SIZE;
+    for (int i = 0; i < level; i++) {
+        size *= SPATIAL_INDEX_LEVEL_FACTOR;
+    }
+    return size;
+}
+
+int CyberiadaSMEditorSpatialIndex::levelOf(const QRectF& rect)
+{
+    // a rect not larger than a cell spans at most 2x2 cells
+    qreal extent = qMax(rect.width(), rect.height());
+    int level = 0;
+    qreal size = SPATIAL_INDEX_CELL_SIZE;
+    while (extent > size && level < SPATIAL_INDEX_MAX_LEVELS - 1) {
+        size *= SPATIAL_INDEX_LEVEL_FACTOR;
+        level++;
+    }
+    return level;
+}
+
+QRect CyberiadaSMEditorSpatialIndex::cellSpan(const QRectF& rect, int level)
+{
+    qreal size = cellSize(level);
+    int left = int(std::floor(rect.left() / size));
+    int top = int(std::floor(rect.top() / size));
+    int right = int(std::floor(rect.right() / size));
+    int bottom = int(std::floor(rect.bottom() / size));
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+void CyberiadaSMEditorSpatialIndex::insert(QGraphicsItem* item, const QRectF& rect, int depth, Kind kind)
+{
+    MY_ASSERT(item);
+    int order;
+    auto it = entries.find(item);
+    if (it != entries.end()) {
+        if (it->rect == rect && it->depth == depth && it->kind == kind) {
+            return;
+        }
+        // keep the stacking order of the item
+        order = it->order;
+        remove(item);
+    } else {
+        order = nextOrder++;
+    }
+
+    Entry entry;
+    entry.rect = rect;
+    entry.depth = depth;
+    entry.order = order;
+    entry.kind = kind;
+    entry.level = levelOf(rect);
+    entries.insert(item, entry);
+
+    if (depth == 0) {
+        topLevel.append(item);
+        return;
+    }
+    if (levels.size() <= entry.level) {
+        levels.resize(entry.level + 1);
+    }
+    Grid& grid = levels[entry.level];
+    QRect span = cellSpan(rect, entry.level);
+    for (int col = span.left(); col <= span.right(); col++) {
+        for (int row = span.top(); row <= span.bottom(); row++) {
+            grid[cellKey(col, row)].append(item);
+        }
+    }
+}
+
+void CyberiadaSMEditorSpatialIndex::remove(const QGraphicsItem* item)
+{
+    auto it = entries.find(item);
+    if (it == entries.end()) {
+        return;
+    }
+    if (it->depth == 0) {
+        topLevel.removeAll(const_cast<QGraphicsItem*>(item));
+    } else {
+        Grid& grid = levels[it->level];
+        QRect span = cellSpan(it->rect, it->level);
+        for (int col = span.left(); col <= span.right(); col++) {
+            for (int row = span.top(); row <= span.bottom(); row++) {
+                auto cell = grid.find(cellKey(col, row));
+                if (cell == grid.end()) {
+                    continue;
+                }
+                cell->removeAll(const_cast<QGraphicsItem*>(item));
+                if (cell->isEmpty()) {
+                    grid.erase(cell);
+                }
+            }
+        }
+    }
+    entries.erase(it);
+}
+
+void CyberiadaSMEditorSpatialIndex::clear()
+{
+    entries.clear();
+    levels.clear();
+    topLevel.clear();
+    nextOrder = 0;
+}
+
+QGraphicsItem* CyberiadaSMEditorSpatialIndex::itemAt(const QPointF& point, int kinds, int minDepth,
+                                                     const QGraphicsItem* exclude) const
+{
+    QGraphicsItem* best = NULL;
+    const Entry* bestEntry = NULL;
+
+    auto check = [&](QGraphicsItem* item) {
+        const Entry& entry = entries.find(item).value();
+        if (!(entry.kind & kinds) || entry.depth < minDepth) {
+            return;
+        }
+        // the top-level bounds follow the children, only the item knows them
+        if (entry.depth > 0 && !entry.rect.contains(point)) {
+            return;
+        }
+        if (bestEntry && (entry.depth < bestEntry->depth ||
+                          (entry.depth == bestEntry->depth && entry.order < bestEntry->order))) {
+            return;
+        }
+        if (exclude && (item == exclude || exclude->isAncestorOf(item))) {
+            return;
+        }
+        if (!item->isVisible() || !item->contains(item->mapFromScene(point))) {
+            return;
+        }
+        best = item;
+        bestEntry = &entry;
+    };
+
+    for (int level = 0; level < levels.size(); level++) {
+        const Grid& grid = levels.at(level);
+        qreal size = cellSize(level);
+        auto cell = grid.find(cellKey(int(std::floor(point.x() / size)),
+                                      int(std::floor(point.y() / size))));
+        if (cell != grid.end()) {
+            for (QGraphicsItem* item : *cell) {
+                check(item);
+            }
+        }
+    }
+    if (best == NULL) {
+        for (QGraphicsItem* item : topLevel) {
+            check(item);
+        }
+    }
+    return best;
+}
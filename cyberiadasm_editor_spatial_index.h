@@ -0,0 +1,93 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ * 
+ * The State Machine Editor Spatial Index
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef CYBERIADA_SM_EDITOR_SPATIAL_INDEX_HEADER
+#define CYBERIADA_SM_EDITOR_SPATIAL_INDEX_HEADER
+
+#include <QGraphicsItem>
+#include <QHash>
+#include <QVector>
+#include <QRectF>
+
+/* -----------------------------------------------------------------------------
+ * Spatial Index
+ * ----------------------------------------------------------------------------- */
+
+// The scene rects of the containers (states, state machines) and the vertices
+// bucketed in a hierarchy of grids: the cells of every level are four times
+// larger than the cells of the level below, and an item is put on the lowest
+// level whose cells are not smaller than the item, so it takes at most 2x2
+// cells there. Inserting or removing an item touches at most four cells; a
+// point query looks at one cell per level (O(log) of the diagram size) instead
+// of sorting all the scene items under the point. Of the items containing the
+// point the deepest one in the hierarchy wins, the later inserted one among
+// the siblings - the same item that is on top in the scene. The top-level
+// items (depth 0) cover the whole diagram and are kept aside.
+class CyberiadaSMEditorSpatialIndex {
+public:
+    enum Kind {
+        Container = 0x01,
+        Vertex = 0x02
+    };
+
+    CyberiadaSMEditorSpatialIndex();
+
+    // (re)inserts the item with its scene rect, replacing the previous entry
+    void  insert(QGraphicsItem* item, const QRectF& rect, int depth, Kind kind);
+    void  remove(const QGraphicsItem* item);
+    void  clear();
+
+    bool  contains(const QGraphicsItem* item) const { return entries.contains(item); }
+    bool  isEmpty() const { return entries.isEmpty(); }
+    int   size() const { return entries.size(); }
+
+    // the deepest visible item of the kinds whose shape contains the scene
+    // point; the excluded item and its descendants are skipped
+    QGraphicsItem* itemAt(const QPointF& point, int kinds, int minDepth = 0,
+                          const QGraphicsItem* exclude = NULL) const;
+
+private:
+    struct Entry {
+        QRectF rect;
+        int    depth;
+        int    order;
+        Kind   kind;
+        int    level;
+    };
+
+    typedef QVector<QGraphicsItem*> Cell;
+    typedef QHash<quint64, Cell>    Grid;
+
+    static quint64 cellKey(int col, int row);
+    static int levelOf(const QRectF& rect);
+    static qreal cellSize(int level);
+    static QRect cellSpan(const QRectF& rect, int level);
+
+    QHash<const QGraphicsItem*, Entry> entries;
+    // the grid levels from the finest one; a level is added on demand
+    QVector<Grid>                      levels;
+    Cell                               topLevel;
+    int                                nextOrder;
+};
+
+#endif
@@ -22,6 +22,7 @@
  * ----------------------------------------------------------------------------- */
 
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QDebug>
 #include <QCursor>
 #include <QGraphicsScene>
@@ -37,6 +38,7 @@
 #include "cyberiadasm_editor_scene.h"
 #include "dialogs/stateactiondialog.h"
 #include "settings_manager.h"
+#include "cyberiadasm_editor_logging.h"
 
 // state action includes
 #include <QTextCursor>
@@ -57,9 +59,11 @@ CyberiadaSMEditorStateItem::CyberiadaSMEditorStateItem(QObject *parent_object,
     CyberiadaSMEditorAbstractItem(model, element, parent)
 {
     setAcceptHoverEvents(true);
-    setFlags(ItemIsSelectable | ItemSendsGeometryChanges);
+    // the outline is painted only where exposed
+    setFlags(ItemIsSelectable | ItemSendsGeometryChanges | ItemUsesExtendedStyleOption);
 
     state = static_cast<const Cyberiada::State*>(element);
+    refreshGeometry();
 
     setPos(QPointF(x(), y()));
     CyberiadaSMEditorAbstractItem::setPreviousPosition(QPointF(x(), y()));
@@ -68,6 +72,7 @@ CyberiadaSMEditorStateItem::CyberiadaSMEditorStateItem(QObject *parent_object,
     title->setFontBoldness(true);
     title->setVisible(SettingsManager::instance().getShowText());
     connect(title, &EditableTextItem::sizeChanged, this, &CyberiadaSMEditorStateItem::onTextItemSizeChanged);
+    updateTitleLine();
 
     initializeActions();
 
@@ -104,9 +109,7 @@ CyberiadaSMEditorStateItem::~CyberiadaSMEditorStateItem()
 }
 
 QPainterPath CyberiadaSMEditorStateItem::shape() const {
-    QPainterPath path;
-    path.addRoundedRect(rect(), ROUNDED_RECT_RADIUS, ROUNDED_RECT_RADIUS);
-    return path;
+    return roundedPath;
 }
 
 void CyberiadaSMEditorStateItem::setRect(qreal x, qreal y, qreal w, qreal h)
@@ -137,33 +140,47 @@ void CyberiadaSMEditorStateItem::setRect(const QRectF &rect)
 }
 
 QRectF CyberiadaSMEditorStateItem::rect() const {
-    Cyberiada::Rect model_rect = state->get_geometry_rect();
-    QRectF rect = QRectF(-model_rect.width / 2, -model_rect.height / 2, model_rect.width, model_rect.height);
-    return rect;
+    return localRect;
 }
 
 qreal CyberiadaSMEditorStateItem::x() const
 {
-    Cyberiada::Rect model_rect = state->get_geometry_rect();
-    return model_rect.x;
+    return geometry.x;
 }
 
 qreal CyberiadaSMEditorStateItem::y() const
 {
-    Cyberiada::Rect model_rect = state->get_geometry_rect();
-    return model_rect.y;
+    return geometry.y;
 }
 
 qreal CyberiadaSMEditorStateItem::width() const
 {
-    Cyberiada::Rect model_rect = state->get_geometry_rect();
-    return model_rect.width;
+    return geometry.width;
 }
 
 qreal CyberiadaSMEditorStateItem::height() const
 {
-    Cyberiada::Rect model_rect = state->get_geometry_rect();
-    return model_rect.height;
+    return geometry.height;
+}
+
+void CyberiadaSMEditorStateItem::refreshGeometry()
+{
+    geometry = state->get_geometry_rect();
+    QRectF r = QRectF(-geometry.width / 2, -geometry.height / 2, geometry.width, geometry.height);
+    if (r != localRect) {
+        prepareGeometryChange();
+        localRect = r;
+        roundedPath = QPainterPath();
+        roundedPath.addRoundedRect(localRect, ROUNDED_RECT_RADIUS, ROUNDED_RECT_RADIUS);
+        updateTitleLine();
+    }
+}
+
+void CyberiadaSMEditorStateItem::updateTitleLine()
+{
+    if (title == nullptr) return;
+    qreal titleHeight = title->boundingRect().height();
+    titleLine = QLineF(localRect.x(), localRect.y() + titleHeight, localRect.right(), localRect.y() + titleHeight);
 }
 
 QString CyberiadaSMEditorStateItem::name() const
@@ -260,6 +277,7 @@ void CyberiadaSMEditorStateItem::setTextPosition()
 void CyberiadaSMEditorStateItem::syncFromModel()
 {
     // qDebug() << "synk" << name() << boundingRect() << pos() - QPointF(x(), y());
+    refreshGeometry();
     QRectF r1 = mapRectToParent(boundingRect());
     // qDebug() << "before" << r1 << name();
     setPos(QPointF(x(), y()));
@@ -276,23 +294,7 @@ void CyberiadaSMEditorStateItem::syncFromModel()
         }
         updateRegion();
     }
-
-    CyberiadaSMEditorAbstractItem* cParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(parentItem());
-    if (cParent == nullptr) {
-        // try to find region parent
-        cParent = dynamic_cast<CyberiadaSMEditorAbstractItem*>(parentItem()->parentItem());
-        MY_ASSERT(cParent);
-    }
-
-    if (cParent->getId() != element->get_parent()->get_id()) {
-        QGraphicsItem* newcParent = (dynamic_cast<CyberiadaSMEditorScene*>(scene())->getMap()).value(element->get_parent()->get_id());
-        QPointF posInThis = mapFromParent(pos());
-        QPointF newCoords = mapToItem(newcParent, posInThis);
-        Cyberiada::Rect newRect = Cyberiada::Rect(newCoords.x(), newCoords.y(), width(), height());
-        setParentItem(newcParent);
-        model->updateGeometry(model->elementToIndex(element), newRect);
-        prevItemUnderCursor = static_cast<CyberiadaSMEditorAbstractItem*>(newcParent);
-    }
+    // the reparenting is done by the scene on the model move
     CyberiadaSMEditorAbstractItem::syncFromModel();
 }
 
@@ -348,12 +350,13 @@ void CyberiadaSMEditorStateItem::updateSizeToFitChildren(CyberiadaSMEditorAbstra
 
     QRectF newRect = boundingRect().united(rect);
 
-    qDebug() << "parent change" << name() << (newRect.width() - boundingRect().width()) / 2 << child->pos();
-    qDebug() << newRect << "|" << boundingRect() << "|" << rect;
+    EDITOR_DEBUG(lcEditorItems) << "parent change" << name() << (newRect.width() - boundingRect().width()) / 2 << child->pos();
+    EDITOR_DEBUG(lcEditorItems) << newRect << "|" << boundingRect() << "|" << rect;
 
     if (newRect.width() - boundingRect().width() == 0 && newRect.height() - boundingRect().height() == 0) {
         return;
     }
+    model->beginTransaction();
     Cyberiada::Rect r = Cyberiada::Rect(x(),
                                         y(),
                                         newRect.width(),
@@ -365,12 +368,14 @@ void CyberiadaSMEditorStateItem::updateSizeToFitChildren(CyberiadaSMEditorAbstra
         // qDebug() << "1";
         r = Cyberiada::Rect(r.x - (newRect.width() - boundingRect().width()) / 2, r.y, r.width - (newRect.width() - boundingRect().width()) / 2, r.height);
         model->updateGeometry(model->elementToIndex(element), r);
+        refreshGeometry();
         emit sizeChanged(CornerFlags::Left, + (newRect.width() - boundingRect().width()) / 2);
     }
     else if (newRect.width() - boundingRect().width() != 0){
         // qDebug() << "2";
         r = Cyberiada::Rect(r.x + (newRect.width() - boundingRect().width()) / 2, r.y, r.width, r.height);
         model->updateGeometry(model->elementToIndex(element), r);
+        refreshGeometry();
         emit sizeChanged(CornerFlags::Right, (newRect.width() - boundingRect().width()) / 2);
     }
 
@@ -378,14 +383,17 @@ void CyberiadaSMEditorStateItem::updateSizeToFitChildren(CyberiadaSMEditorAbstra
         // qDebug() << "3";
         r = Cyberiada::Rect(r.x, r.y - (newRect.height() - boundingRect().height()) / 2, r.width, r.height);
         model->updateGeometry(model->elementToIndex(element), r);
+        refreshGeometry();
         emit sizeChanged(CornerFlags::Top, - (newRect.height() - boundingRect().height()) / 2);
     }
     else if (newRect.height() - boundingRect().height() != 0) {
         // qDebug() << "4";
         r = Cyberiada::Rect(r.x, r.y + (newRect.height() - boundingRect().height()) / 2, r.width, r.height);
         model->updateGeometry(model->elementToIndex(element), r);
+        refreshGeometry();
         emit sizeChanged(CornerFlags::Bottom, (newRect.height() - boundingRect().height()) / 2);
     }
+    model->commitTransaction();
 }
 
 QStringList CyberiadaSMEditorStateItem::getSameLevelStateNames() const
@@ -419,6 +427,7 @@ QStringList CyberiadaSMEditorStateItem::getSameLevelStateNames() const
 
 void CyberiadaSMEditorStateItem::onTextItemSizeChanged()
 {
+    updateTitleLine();
     if (state->is_composite_state()) updateRegion();
     setTextPosition();
 }
@@ -446,40 +455,51 @@ void CyberiadaSMEditorStateItem::onActionChanged(StateAction* signalOwner)
     model->updateAction(model->elementToIndex(element), i, QString(), QString(), signalOwner->getBehavior());
 }
 
-void CyberiadaSMEditorStateItem::slotInspectorModeChanged(bool on)
+void CyberiadaSMEditorStateItem::inspectorModeChanged(bool on)
 {
     if (state->is_composite_state()) {
         region->setVisibleRegon(on);
     }
-    update();
 }
 
 void CyberiadaSMEditorStateItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget){
-    Q_UNUSED(option)
     Q_UNUSED(widget)
 
+    const CyberiadaSMEditorStyle& st = style();
     QPen pen = QPen(Qt::black, 2, Qt::SolidLine);
     if (isSelected() || isHighlighted) {
-        SettingsManager& sm = SettingsManager::instance();
-        pen.setColor(sm.getSelectionColor());
-        pen.setWidth(sm.getSelectionBorderWidth());
-        QColor fillColor = sm.getSelectionColor();
+        pen.setColor(st.selectionColor);
+        pen.setWidth(st.selectionBorderWidth);
+        QColor fillColor = st.selectionColor;
         fillColor.setAlpha(50);
         painter->setBrush(QBrush(fillColor));
+    } else if (!st.inspectorMode) {
+        // an edit inside a composite state exposes its interior only; the
+        // rounded corners stay within the radius from the edges
+        bool exposed = isFrameExposed(localRect, pen.widthF() + ROUNDED_RECT_RADIUS, option->exposedRect);
+        if (!exposed && st.showText) {
+            QRectF line = QRectF(titleLine.p1(), titleLine.p2()).normalized();
+            exposed = line.adjusted(-pen.widthF(), -pen.widthF(), pen.widthF(), pen.widthF()).intersects(option->exposedRect);
+        }
+        if (!exposed) {
+            return;
+        }
     }
 
     painter->setPen(pen);
 
-    QPainterPath path;
-    QRectF tmpRect = rect();
-    path.addRoundedRect(tmpRect, ROUNDED_RECT_RADIUS, ROUNDED_RECT_RADIUS);
-    if (SettingsManager::instance().getShowText()) {
-        qreal titleHeight = title->boundingRect().height();
-        painter->drawLine(QPointF(tmpRect.x(), tmpRect.y() + titleHeight), QPointF(tmpRect.right(), tmpRect.y() + titleHeight));
+    if (option->levelOfDetailFromTransform(painter->worldTransform()) < LOD_SHAPE_THRESHOLD) {
+        // zoomed out: neither the corners nor the title line are visible
+        painter->drawRect(rect());
+        return;
     }
-    painter->drawPath(path);
 
-    if (SettingsManager::instance().getInspectorMode()) {
+    if (st.showText) {
+        painter->drawLine(titleLine);
+    }
+    painter->drawPath(roundedPath);
+
+    if (st.inspectorMode) {
         painter->setBrush(Qt::red);
         painter->drawEllipse(QPointF(0, 0), 2, 2); // The center of the coordinate system
     }
@@ -586,12 +606,31 @@ void CyberiadaSMEditorStateItem::contextMenuEvent(QGraphicsSceneContextMenuEvent
 
 void CyberiadaSMEditorStateItem::updateParent(CyberiadaSMEditorAbstractItem *newParent)
 {
+    Cyberiada::ID parentId;
     if (newParent == nullptr) {
-        model->updateParent(model->elementToIndex(element), model->rootDocument()->get_parent_sm(element)->get_id());
-        // TODO update geometry pos
+        parentId = model->rootDocument()->get_parent_sm(element)->get_id();
     } else {
-        model->updateParent(model->elementToIndex(element), newParent->getId());
+        parentId = newParent->getId();
+    }
+    QGraphicsItem* container = dynamic_cast<CyberiadaSMEditorScene*>(scene())->getRegistry().item(parentId);
+    if (container == nullptr || element->get_parent()->get_id() == parentId) {
+        return;
+    }
+    // the state stays in place: the model coordinates are relative to the
+    // parent (to the region of a composite state)
+    CyberiadaSMEditorStateItem* parentState = dynamic_cast<CyberiadaSMEditorStateItem*>(container);
+    if (parentState && parentState->getRegion()) {
+        container = parentState->getRegion();
+    }
+    QPointF newCoords = container->mapFromScene(scenePos());
+    Cyberiada::Rect newRect = Cyberiada::Rect(newCoords.x(), newCoords.y(), width(), height());
+    model->beginTransaction();
+    model->updateParent(model->elementToIndex(element), parentId);
+    if (element->get_parent()->get_id() == parentId) {
+        model->updateGeometry(model->elementToIndex(element), newRect);
+        refreshGeometry();
     }
+    model->commitTransaction();
 }
 
 /* -----------------------------------------------------------------------------
@@ -704,6 +743,7 @@ void StateTitle::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
                                                 state->boundingRect().width(),
                                                 state->boundingRect().height());
             state->model->updateGeometry(state->model->elementToIndex(state->element), r);
+            state->refreshGeometry();
             startPos = event->scenePos();
 
             if (state->parentItem()) {
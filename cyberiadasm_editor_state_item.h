@@ -29,6 +29,7 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsRectItem>
 #include <QPainter>
+#include <QPainterPath>
 #include <QDebug>
 
 #include "dotsignal.h"
@@ -77,6 +78,7 @@ public:
     QRectF boundingRect() const override;
 
     void syncFromModel() override;
+    void inspectorModeChanged(bool on) override;
 
     void setTextPosition();
 
@@ -86,6 +88,8 @@ private:
     void initializeActions();
     void addAction(Cyberiada::ActionType type);
     void updateSizeToFitChildren(CyberiadaSMEditorAbstractItem* child) override;
+    void refreshGeometry() override;
+    void updateTitleLine();
 
 signals:
     void rectChanged(CyberiadaSMEditorStateItem *rect);
@@ -99,8 +103,6 @@ private slots:
     void onActionDeleted(StateAction* signalOwner);
     void onActionChanged(StateAction* signalOwner);
 
-    void slotInspectorModeChanged(bool on) override;
-
 protected:
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
 
@@ -110,11 +112,17 @@ protected:
     void contextMenuEvent(QGraphicsSceneContextMenuEvent *event) override;
 
 private:
-    StateTitle* title;
+    StateTitle* title = nullptr;
     StateAction* entry = nullptr;
     StateAction* exit = nullptr;
 
     QRectF m_rect;
+    // the model geometry and the paths built from it, refreshed by
+    // syncFromModel() instead of being re-read on every paint and hit test
+    Cyberiada::Rect geometry;
+    QRectF localRect;
+    QPainterPath roundedPath;
+    QLineF titleLine;
     StateRegion* region = nullptr;
     const Cyberiada::State* state;
     std::vector<StateAction*> actions;
@@ -23,6 +23,7 @@
 
 #include <cstdio>
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QDebug>
 #include <QGraphicsSceneMouseEvent>
 #include <QtMath>
@@ -37,6 +38,7 @@
 #include "cyberiada_constants.h"
 #include "cyberiadasm_editor_scene.h"
 #include "settings_manager.h"
+#include "cyberiadasm_editor_logging.h"
 
 // QLineF::intersect was deprecated in favour of intersects in Qt 5.14
 static QLineF::IntersectType lineIntersect(const QLineF& a, const QLineF& b, QPointF* point)
@@ -56,10 +58,10 @@ CyberiadaSMEditorTransitionItem::CyberiadaSMEditorTransitionItem(QObject *parent
                                                                  CyberiadaSMModel *model,
                                                                  Cyberiada::Element *element,
                                                                  QGraphicsItem *parent,
-                                                                 QMap<Cyberiada::ID, QGraphicsItem*>& elementItem) :
+                                                                 CyberiadaSMEditorItemRegistry& registry) :
     CyberiadaSMEditorAbstractItem(model, element, parent),
     // QObject(parent_object),
-    elementIdToItemMap(elementItem)
+    itemRegistry(registry)
 {
     setAcceptHoverEvents(true);
     setFlags(ItemIsSelectable|ItemSendsGeometryChanges);
@@ -72,7 +74,6 @@ CyberiadaSMEditorTransitionItem::CyberiadaSMEditorTransitionItem(QObject *parent
 
     actionItem = new TransitionAction(actionText(), this);
     setActionVisibility(SettingsManager::instance().getShowTransitionText());
-    connect(&SettingsManager::instance(), &SettingsManager::showTransitionTextChanged, this, &CyberiadaSMEditorTransitionItem::setActionVisibility);
 
     connect(target(), &CyberiadaSMEditorAbstractItem::geometryChanged, this, &CyberiadaSMEditorTransitionItem::onTargetGeomertyChanged);
     connect(source(), &CyberiadaSMEditorAbstractItem::geometryChanged, this, &CyberiadaSMEditorTransitionItem::onSourceGeomertyChanged);
@@ -100,20 +101,28 @@ QRectF CyberiadaSMEditorTransitionItem::boundingRect() const
 {
     MY_ASSERT(model);
     MY_ASSERT(model->rootDocument());
-    return path().boundingRect().adjusted(-10, -10, 10, 10); // Увеличиваем область для стрелки
+    ensureGeometry();
+    return cachedBounds;
 }
 
 void CyberiadaSMEditorTransitionItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
     QPen pen = QPen(Qt::black, 2, Qt::SolidLine);
     if (isSelected()) {
-        SettingsManager& sm = SettingsManager::instance();
-        pen.setColor(sm.getSelectionColor());
-        pen.setWidth(sm.getSelectionBorderWidth());
+        const CyberiadaSMEditorStyle& st = style();
+        pen.setColor(st.selectionColor);
+        pen.setWidth(st.selectionBorderWidth);
     }
 
     painter->setPen(pen);
     painter->setBrush(Qt::NoBrush);
+
+    if (option->levelOfDetailFromTransform(painter->worldTransform()) < LOD_SHAPE_THRESHOLD) {
+        // zoomed out: a straight polyline without the loop arc and the arrowhead
+        painter->drawPolyline(polyline());
+        return;
+    }
+
     painter->drawPath(path());
 
     drawArrow(painter);
@@ -121,14 +130,19 @@ void CyberiadaSMEditorTransitionItem::paint(QPainter *painter, const QStyleOptio
 
 QPainterPath CyberiadaSMEditorTransitionItem::shape() const
 {
-    QPainterPathStroker stroker;
-    stroker.setWidth(5);
-    return stroker.createStroke(path());
+    ensureGeometry();
+    if (!shapeValid) {
+        QPainterPathStroker stroker;
+        stroker.setWidth(5);
+        cachedShape = stroker.createStroke(cachedPath);
+        shapeValid = true;
+    }
+    return cachedShape;
 }
 
 CyberiadaSMEditorAbstractItem *CyberiadaSMEditorTransitionItem::source() const
 {
-    return static_cast<CyberiadaSMEditorAbstractItem*>(elementIdToItemMap.value(transition->source_element_id()));
+    return static_cast<CyberiadaSMEditorAbstractItem*>(itemRegistry.item(transition->source_element_id()));
 }
 
 void CyberiadaSMEditorTransitionItem::setSource(CyberiadaSMEditorAbstractItem *newSource)
@@ -174,14 +188,14 @@ QPointF CyberiadaSMEditorTransitionItem::sourceCenter() const
 {
     Cyberiada::ID id = transition->source_element_id();
 
-    if(!elementIdToItemMap.value(id)) return QPoint(); //костыль
-    MY_ASSERT(elementIdToItemMap.value(id));
-    return (elementIdToItemMap.value(id))->sceneBoundingRect().center();
+    if(!itemRegistry.item(id)) return QPoint(); //костыль
+    MY_ASSERT(itemRegistry.item(id));
+    return (itemRegistry.item(id))->sceneBoundingRect().center();
 }
 
 CyberiadaSMEditorAbstractItem *CyberiadaSMEditorTransitionItem::target() const
 {
-    return static_cast<CyberiadaSMEditorAbstractItem*>(elementIdToItemMap.value(transition->target_element_id()));
+    return static_cast<CyberiadaSMEditorAbstractItem*>(itemRegistry.item(transition->target_element_id()));
 }
 
 void CyberiadaSMEditorTransitionItem::setTarget(CyberiadaSMEditorAbstractItem *newTarget)
@@ -218,12 +232,70 @@ void CyberiadaSMEditorTransitionItem::setTargetPoint(const QPointF &point)
 
 QPointF CyberiadaSMEditorTransitionItem::targetCenter() const
 {
-    if(!elementIdToItemMap.value(transition->target_element_id())) return QPoint(); //костыль
-    MY_ASSERT(elementIdToItemMap.value(transition->target_element_id()));
-    return (elementIdToItemMap.value(transition->target_element_id()))->sceneBoundingRect().center();
+    if(!itemRegistry.item(transition->target_element_id())) return QPoint(); //костыль
+    MY_ASSERT(itemRegistry.item(transition->target_element_id()));
+    return (itemRegistry.item(transition->target_element_id()))->sceneBoundingRect().center();
 }
 
 QPainterPath CyberiadaSMEditorTransitionItem::path() const
+{
+    ensureGeometry();
+    return cachedPath;
+}
+
+void CyberiadaSMEditorTransitionItem::invalidatePath()
+{
+    prepareGeometryChange();
+    geometryValid = false;
+    shapeValid = false;
+}
+
+void CyberiadaSMEditorTransitionItem::ensureGeometry() const
+{
+    bool tracking = isSourceTraking || isTargetTraking;
+    if (geometryValid &&
+        cachedSourceTraking == isSourceTraking && cachedTargetTraking == isTargetTraking &&
+        (!tracking || cachedPrevPosition == prevPosition)) {
+        return;
+    }
+    cachedPath = buildPath();
+    cachedArrowHead = buildArrowHead(cachedPath);
+    cachedBounds = cachedPath.boundingRect().adjusted(-10, -10, 10, 10); // Увеличиваем область для стрелки
+    cachedSourceTraking = isSourceTraking;
+    cachedTargetTraking = isTargetTraking;
+    cachedPrevPosition = prevPosition;
+    geometryValid = true;
+    shapeValid = false;
+}
+
+void CyberiadaSMEditorTransitionItem::movePathPoint(int index, const QPointF& point)
+{
+    // a polyline dot: only the two segments around it change
+    ensureGeometry();
+    // the path elements match the polyline points only when the path is
+    // built of lines; a loop is drawn with arcs (several curve elements
+    // each), so it is rebuilt from the model instead
+    bool lines = index > 0 && index < cachedPath.elementCount();
+    for (int i = 1; lines && i < cachedPath.elementCount(); i++) {
+        lines = cachedPath.elementAt(i).isLineTo();
+    }
+    if (!lines) {
+        listDots.at(index)->setPos(point);
+        invalidatePath();
+        return;
+    }
+    prepareGeometryChange();
+    cachedPath.setElementPositionAt(index, point.x(), point.y());
+    if (index == cachedPath.elementCount() - 2) {
+        cachedArrowHead = buildArrowHead(cachedPath);
+    }
+    cachedBounds = cachedPath.boundingRect().adjusted(-10, -10, 10, 10);
+    shapeValid = false;
+    listDots.at(index)->setPos(point);
+    dotMoved = true;
+}
+
+QPainterPath CyberiadaSMEditorTransitionItem::buildPath() const
 {
     MY_ASSERT(model);
     QPainterPath path = QPainterPath();
@@ -309,6 +381,19 @@ QPainterPath CyberiadaSMEditorTransitionItem::path() const
     return path;
 }
 
+QPolygonF CyberiadaSMEditorTransitionItem::polyline() const
+{
+    QPolygonF points;
+    points << (isSourceTraking ? prevPosition : sourcePoint() + sourceCenter());
+    if (transition->has_polyline() && source() != target()) {
+        for (const auto& point : transition->get_geometry_polyline()) {
+            points << QPointF(point.x, point.y) + sourceCenter();
+        }
+    }
+    points << (isTargetTraking ? prevPosition : targetPoint() + targetCenter());
+    return points;
+}
+
 DotSignal *CyberiadaSMEditorTransitionItem::getDot(int index)
 {
     if (index < 0) return nullptr;
@@ -318,15 +403,21 @@ DotSignal *CyberiadaSMEditorTransitionItem::getDot(int index)
 
 void CyberiadaSMEditorTransitionItem::drawArrow(QPainter* painter)
 {
-    SettingsManager& sm = SettingsManager::instance();
-
     QPen pen(Qt::black, 1);
     if (isSelected()) {
-        pen.setColor(sm.getSelectionColor());
-        pen.setWidth(sm.getSelectionBorderWidth());
+        const CyberiadaSMEditorStyle& st = style();
+        pen.setColor(st.selectionColor);
+        pen.setWidth(st.selectionBorderWidth);
     }
     painter->setPen(pen);
 
+    ensureGeometry();
+    painter->setBrush(QBrush(pen.color()));
+    painter->drawPolygon(cachedArrowHead);
+}
+
+QPolygonF CyberiadaSMEditorTransitionItem::buildArrowHead(const QPainterPath& path) const
+{
     double angle;
 
     QPointF p1 = sourcePoint() + sourceCenter();
@@ -354,9 +445,10 @@ void CyberiadaSMEditorTransitionItem::drawArrow(QPainter* painter)
             angle += M_PI / 2;
         }
     } else {
-        if(transition->has_polyline()) {
-            Cyberiada::Polyline polyline = transition->get_geometry_polyline();
-            p1 = QPointF(polyline.back().x, polyline.back().y) + sourceCenter();
+        // the last segment of the polyline path
+        int n = path.elementCount();
+        if (n >= 2) {
+            p1 = path.elementAt(n - 2);
         }
 
         QLineF line(p1, p2);
@@ -371,27 +463,14 @@ void CyberiadaSMEditorTransitionItem::drawArrow(QPainter* painter)
 
     QPolygonF arrowHead;
     arrowHead << p2 << arrowP1 << arrowP2;
-
-    painter->setBrush(QBrush(pen.color()));
-    painter->drawPolygon(arrowHead);
+    return arrowHead;
 }
 
 CyberiadaSMEditorAbstractItem *CyberiadaSMEditorTransitionItem::itemUnderCursor()
 {
-    QList<QGraphicsItem*> items = scene()->items(prevPosition);
-
-    CyberiadaSMEditorAbstractItem* cItem = nullptr;
-    for (QGraphicsItem* item : items) {
-        cItem = dynamic_cast<CyberiadaSMEditorAbstractItem*>(item);
-        if (!cItem) { continue; }
-
-        if (cItem->type() == CyberiadaSMEditorAbstractItem::StateItem ||
-            cItem->type() == CyberiadaSMEditorAbstractItem::CompositeStateItem ||
-            cItem->type() == CyberiadaSMEditorAbstractItem::VertexItem) {
-            return cItem;
-        }
-    }
-    return nullptr;
+    CyberiadaSMEditorScene* cScene = dynamic_cast<CyberiadaSMEditorScene*>(scene());
+    if (!cScene) return nullptr;
+    return cScene->connectableAt(prevPosition);
 }
 
 QPointF CyberiadaSMEditorTransitionItem::findIntersectionWithItem(const CyberiadaSMEditorAbstractItem *item,
@@ -540,7 +619,16 @@ void CyberiadaSMEditorTransitionItem::setActionVisibility(bool visible) {
 
 void CyberiadaSMEditorTransitionItem::syncFromModel()
 {
-    prepareGeometryChange();
+    if (dotMoved) {
+        // the cache & the dots already follow the dragged polyline dot; the
+        // path is rebuilt from the model when the dot is released
+        if (transition->has_action()) {
+            updateAction();
+        }
+        update();
+        return;
+    }
+    invalidatePath();
     if (transition->has_action()) {
         updateAction();
     }
@@ -551,21 +639,21 @@ void CyberiadaSMEditorTransitionItem::syncFromModel()
 
 void CyberiadaSMEditorTransitionItem::onSourceGeomertyChanged()
 {
-    prepareGeometryChange();
+    invalidatePath();
     updateActionPosition();
     setDotsPosition();
 }
 
 void CyberiadaSMEditorTransitionItem::onTargetGeomertyChanged()
 {
-    prepareGeometryChange();
+    invalidatePath();
     updateActionPosition();
     setDotsPosition();
 }
 
 void CyberiadaSMEditorTransitionItem::onSourceSizeChanged(CyberiadaSMEditorAbstractItem::CornerFlags side, qreal d)
 {
-    prepareGeometryChange();
+    invalidatePath();
     QPointF newPosition = sourcePoint();
     updateCoordinates(side, newPosition, d);
     setSourcePoint(newPosition);
@@ -573,7 +661,7 @@ void CyberiadaSMEditorTransitionItem::onSourceSizeChanged(CyberiadaSMEditorAbstr
 
 void CyberiadaSMEditorTransitionItem::onTargetSizeChanged(CyberiadaSMEditorAbstractItem::CornerFlags side, qreal d)
 {
-    prepareGeometryChange();
+    invalidatePath();
     QPointF newPosition = targetPoint();
     updateCoordinates(side, newPosition, d);
     setTargetPoint(newPosition);
@@ -601,7 +689,7 @@ void CyberiadaSMEditorTransitionItem::slotMoveDot(QGraphicsItem *signalOwner, qr
 
                     // loop
                     if (cItem == target()) {
-                        qDebug() << "1";
+                        EDITOR_DEBUG(lcEditorTransition) << "1";
                         setSource(cItem);
                         hasIntersections = false;
                         QPointF newPoint = findIntersectionWithItem(source(), p, sourceCenter(), &hasIntersections) -
@@ -613,7 +701,7 @@ void CyberiadaSMEditorTransitionItem::slotMoveDot(QGraphicsItem *signalOwner, qr
 
                     //
                     if (cItem == source()) {
-                        qDebug() << "2";
+                        EDITOR_DEBUG(lcEditorTransition) << "2";
                         hasIntersections = false;
                         QPointF newPoint = findIntersectionWithItem(source(), p, nextPoint, &hasIntersections) -
                                            sourceCenter();
@@ -628,14 +716,14 @@ void CyberiadaSMEditorTransitionItem::slotMoveDot(QGraphicsItem *signalOwner, qr
                                cItem->sceneBoundingRect().center();
                     // intersectoin with item under cursor
                     if (hasIntersections) {
-                        qDebug() << "3";
+                        EDITOR_DEBUG(lcEditorTransition) << "3";
                         isSourceTraking = false;
                         setSource(cItem);
                         setSourcePoint(newPoint);
                         return;
                     }
 
-                    qDebug() << "3.5";
+                    EDITOR_DEBUG(lcEditorTransition) << "3.5";
                     return;
                 }
                 bool hasIntersections = false;
@@ -650,12 +738,12 @@ void CyberiadaSMEditorTransitionItem::slotMoveDot(QGraphicsItem *signalOwner, qr
                 // intersection with source in adjusted bounding rect
                 if (hasIntersections) {
                     isSourceTraking = false;
-                    qDebug() << "4" << isSourceTraking << isTargetTraking;
+                    EDITOR_DEBUG(lcEditorTransition) << "4" << isSourceTraking << isTargetTraking;
                     setSourcePoint(newPoint);
                     return;
                 }
 
-                qDebug() << "5";
+                EDITOR_DEBUG(lcEditorTransition) << "5";
 
                 // mouse traking
                 isSourceTraking = true;
@@ -734,6 +822,7 @@ void CyberiadaSMEditorTransitionItem::slotMoveDot(QGraphicsItem *signalOwner, qr
             p.x += dx;
             p.y += dy;
             pol.at(i - 1) = p;
+            movePathPoint(i, QPointF(p.x, p.y) + sourceCenter());
             model->updateGeometry(model->elementToIndex(element), pol);
             break;
         }
@@ -742,6 +831,10 @@ void CyberiadaSMEditorTransitionItem::slotMoveDot(QGraphicsItem *signalOwner, qr
 
 void CyberiadaSMEditorTransitionItem::slotMouseReleaseDot()
 {
+    // the patched path is dropped: the changes synced during the drag (the
+    // ends moved, an undo) are applied to the rebuilt one
+    dotMoved = false;
+    invalidatePath();
     isSourceTraking = false;
     isTargetTraking = false;
 }
@@ -1035,6 +1128,9 @@ QString TransitionAction::getBehaviour() const
 }
 
 void TransitionAction::paint(QPainter *painter, const QStyleOptionGraphicsItem *o, QWidget *w) {
+    if (!hasFocus() && o->levelOfDetailFromTransform(painter->worldTransform()) < LOD_TEXT_THRESHOLD) {
+        return;
+    }
     if (!toPlainText().isEmpty()) {
         QColor color = painter->background().color();
         color.setAlpha(150);
@@ -35,6 +35,7 @@
 #include <QPainter>
 
 #include "cyberiadasm_editor_items.h"
+#include "cyberiadasm_editor_registry.h"
 #include "dotsignal.h"
 #include "editable_text_item.h"
 
@@ -57,7 +58,7 @@ public:
                         CyberiadaSMModel *model,
                         Cyberiada::Element *element,
                         QGraphicsItem *parent,
-                        QMap<Cyberiada::ID, QGraphicsItem*> &elementItem);
+                        CyberiadaSMEditorItemRegistry &registry);
     ~CyberiadaSMEditorTransitionItem();
 
     virtual int type() const { return TransitionItem; }
@@ -86,7 +87,11 @@ public:
     }
 
     QPainterPath path() const;
+    // the path points without the loop arc (the zoomed out rendering)
+    QPolygonF polyline() const;
     void updatePath();
+    // drops the cached path, arrowhead, shape and bounds (an endpoint has changed)
+    void invalidatePath();
 
     DotSignal* getDot(int index);
 
@@ -121,6 +126,10 @@ protected:
 
 private:
     void drawArrow(QPainter* painter);
+    QPainterPath buildPath() const;
+    QPolygonF buildArrowHead(const QPainterPath& path) const;
+    void ensureGeometry() const;
+    void movePathPoint(int index, const QPointF& point);
     CyberiadaSMEditorAbstractItem* itemUnderCursor();
     QPointF findIntersectionWithItem(const CyberiadaSMEditorAbstractItem *item,
                                      const QPointF& start, const QPointF& end,
@@ -138,13 +147,28 @@ private:
 
     QList<DotSignal *> listDots;
 
-    QMap<Cyberiada::ID, QGraphicsItem*>& elementIdToItemMap;
+    CyberiadaSMEditorItemRegistry& itemRegistry;
 
     bool isLeftMouseButtonPressed;
     bool isMouseTraking;
     bool isSourceTraking;
     bool isTargetTraking;
 
+    // the geometry cache: rebuilt on demand after invalidatePath() or when
+    // the mouse tracking of an end changes
+    mutable bool geometryValid = false;
+    mutable bool shapeValid = false;
+    mutable bool cachedSourceTraking = false;
+    mutable bool cachedTargetTraking = false;
+    mutable QPointF cachedPrevPosition;
+    mutable QPainterPath cachedPath;
+    mutable QPolygonF cachedArrowHead;
+    mutable QPainterPath cachedShape;
+    mutable QRectF cachedBounds;
+    // a polyline dot is being dragged: the cache is patched ahead of the
+    // model syncs until the dot is released
+    bool dotMoved = false;
+
     void initializeDots() override;
     void updateDots();
     void showDots() override;
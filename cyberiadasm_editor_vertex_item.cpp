@@ -44,6 +44,7 @@ CyberiadaSMEditorVertexItem::CyberiadaSMEditorVertexItem(CyberiadaSMModel* model
 {
     Cyberiada::Rect r = element->get_bound_rect(*(model->rootDocument()));
     setPos(r.x, r.y);
+    circlePath.addEllipse(fullCircle());
 
     setAcceptHoverEvents(true);
     setFlags(ItemIsSelectable | ItemSendsGeometryChanges);
@@ -59,7 +60,6 @@ QRectF CyberiadaSMEditorVertexItem::boundingRect() const
 }
 
 QPainterPath CyberiadaSMEditorVertexItem::shape() const {
-    QPainterPath path;
     // Cyberiada::ElementType type = element->get_type();
     // if (type == Cyberiada::elementInitial) {
     //     path.addEllipse(fullCircle());
@@ -69,14 +69,18 @@ QPainterPath CyberiadaSMEditorVertexItem::shape() const {
     //     MY_ASSERT(type == Cyberiada::elementTerminate);
     //     path.addEllipse(fullCircle());
     // }
-    path.addEllipse(fullCircle());
-    return path;
+    return circlePath;
+}
+
+void CyberiadaSMEditorVertexItem::syncFromModel()
+{
+    Cyberiada::Rect r = element->get_bound_rect(*(model->rootDocument()));
+    setPos(r.x, r.y);
+    CyberiadaSMEditorAbstractItem::syncFromModel();
 }
 
 QRectF CyberiadaSMEditorVertexItem::fullCircle() const
 {
-    MY_ASSERT(model);
-    MY_ASSERT(model->rootDocument());
     return QRectF(- VERTEX_POINT_RADIUS,
                   - VERTEX_POINT_RADIUS,
                   VERTEX_POINT_RADIUS * 2,
@@ -85,8 +89,6 @@ QRectF CyberiadaSMEditorVertexItem::fullCircle() const
 
 QRectF CyberiadaSMEditorVertexItem::partialCircle() const
 {
-    MY_ASSERT(model);
-    MY_ASSERT(model->rootDocument());
     // Cyberiada::Rect r = element->get_bound_rect(*(model->rootDocument()));
     return QRectF(- VERTEX_POINT_RADIUS * 2.0 / 3.0,
                   - VERTEX_POINT_RADIUS * 2.0 / 3.0,
@@ -98,8 +100,7 @@ void CyberiadaSMEditorVertexItem::paint(QPainter* painter, const QStyleOptionGra
 {
     QColor color(Qt::black);
     if (isSelected()) {
-        SettingsManager& sm = SettingsManager::instance();
-        color = sm.getSelectionColor();
+        color = style().selectionColor;
     }
     painter->setPen(QPen(color, 1, Qt::SolidLine));
     Cyberiada::ElementType type = element->get_type();
@@ -116,7 +117,7 @@ void CyberiadaSMEditorVertexItem::paint(QPainter* painter, const QStyleOptionGra
 
         painter->setPen(QPen(color, 2, Qt::SolidLine));
         QRectF r = fullCircle();
-        painter->drawEllipse(fullCircle());
+        painter->drawEllipse(r);
         painter->drawLine(r.left(), r.top(), r.right(), r.bottom());
         painter->drawLine(r.right(), r.top(), r.left(), r.bottom());
     }
@@ -133,11 +134,14 @@ void CyberiadaSMEditorVertexItem::mouseMoveEvent(QGraphicsSceneMouseEvent *event
 
     if (isLeftMouseButtonPressed) {
         setFlag(ItemIsMovable);
-        model->updateGeometry(model->elementToIndex(element),
-                              Cyberiada::Point(pos().x(), pos().y()));
     }
 
     QGraphicsItem::mouseMoveEvent(event);
+    if (isLeftMouseButtonPressed) {
+        // the model follows the moved item, syncFromModel() keeps it in place
+        model->updateGeometry(model->elementToIndex(element),
+                              Cyberiada::Point(pos().x(), pos().y()));
+    }
     emit geometryChanged();
 }
 
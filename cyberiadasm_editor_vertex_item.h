@@ -24,6 +24,8 @@
 #ifndef CYBERIADASMEDITORVERTEXITEM_H
 #define CYBERIADASMEDITORVERTEXITEM_H
 
+#include <QPainterPath>
+
 #include "cyberiadasm_editor_items.h"
 #include "dotsignal.h"
 
@@ -42,6 +44,8 @@ public:
     QRectF boundingRect() const override;
     QPainterPath shape() const override;
 
+    void syncFromModel() override;
+
 protected:
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
@@ -50,6 +54,9 @@ protected:
 private:
     QRectF fullCircle() const;
     QRectF partialCircle() const;
+
+    // the vertex size does not depend on the model, the shape is built once
+    QPainterPath circlePath;
 };
 
 
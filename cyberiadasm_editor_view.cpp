@@ -32,14 +32,21 @@ CyberiadaSMGraphicsView::CyberiadaSMGraphicsView(QWidget *parent):
 	QGraphicsView(parent)
 {
     setAttribute(Qt::WA_TranslucentBackground, false);
-	setViewportUpdateMode(BoundingRectViewportUpdate);
+    // a local edit repaints the bounds of the changed items only, many
+    // scattered changes fall back to their bounding rect
+	setViewportUpdateMode(SmartViewportUpdate);
+    // the frame & the grid are redrawn on the settings, scene rect or zoom
+    // changes only (see CyberiadaSMEditorScene::slotBackgroundChanged)
+    setCacheMode(CacheBackground);
 
 	setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
 
     setRenderHint(QPainter::Antialiasing);
-	setOptimizationFlags(DontSavePainterState);
-    setOptimizationFlags(DontAdjustForAntialiasing);
+    // no optimization flags: the outlines are drawn along the item bounds, so
+    // the exposed areas keep the antialiasing margin (the targeted repaints
+    // would leave trails otherwise), and the items do not restore the painter
+    // state themselves
 
 	setFocus();
 
@@ -23,6 +23,7 @@
 
 #include <QIcon>
 #include <QList>
+#include <algorithm>
 #include <QMimeData>
 #include <QDebug>
 
@@ -34,6 +35,11 @@ CyberiadaSMModel::CyberiadaSMModel(QObject *parent):
 	QAbstractItemModel(parent)
 {
 	root = NULL;
+	transactionLevel = 0;
+	openStep = NULL;
+	continuousEdit = false;
+	replaying = false;
+	documentModified = false;
 	icons[Cyberiada::elementRoot] = QIcon(":/Icons/images/sm-root.png");
 	icons[Cyberiada::elementSM] = QIcon(":/Icons/images/sm.png");
 	icons[Cyberiada::elementSimpleState] = QIcon(":/Icons/images/state.png");
@@ -62,53 +68,182 @@ void CyberiadaSMModel::reset()
 	if (root) {
 		root->reset();
 	}	
+	documentPath.clear();
+	rebuildIndex();
+	clearUndoHistory();
 	endResetModel();	
 }
 
-bool CyberiadaSMModel::loadDocument(const QString& path, bool reconstruct, bool reconstruct_sm)
+bool CyberiadaSMModel::loadDocument(const QString& path, bool reconstruct, bool reconstruct_sm, CyberiadaSMCacheMode cache)
+{
+	Cyberiada::LocalDocument* new_doc = parseDocument(path, reconstruct, reconstruct_sm, lastLoadError, cache);
+	if (!new_doc) {
+		return false;
+	}
+	setDocument(new_doc, path);
+	return true;
+}
+
+Cyberiada::LocalDocument* CyberiadaSMModel::parseDocument(const QString& path, bool reconstruct, bool reconstruct_sm,
+														  QString& error, CyberiadaSMCacheMode cache)
 {
 	Cyberiada::LocalDocument* new_doc = NULL;
+	// the editor items work in the Qt coordinates
+	Cyberiada::DocumentGeometryFormat geometry = Cyberiada::geometryFormatQt;
+
+	error.clear();
+	// the reconstructed documents differ from the file, they are never cached
+	if (reconstruct || reconstruct_sm) {
+		cache = cacheDisabled;
+	}
+	if (cache == cacheEnabled) {
+		new_doc = readDocumentCache(path, geometry);
+		if (new_doc) {
+			return new_doc;
+		}
+	}
 
-	lastLoadError.clear();
 	try {
 		new_doc = new Cyberiada::LocalDocument();
-		new_doc->open(path.toStdString(), Cyberiada::formatDetect, Cyberiada::geometryFormatQt,
+		new_doc->open(path.toStdString(), Cyberiada::formatDetect, geometry,
 					  reconstruct, reconstruct_sm);
 	} catch (const Cyberiada::XMLException& e) {
-		lastLoadError = tr("XML grapml error:\n") + QString(e.str().c_str());
+		error = tr("XML grapml error:\n") + QString(e.str().c_str());
 	} catch (const Cyberiada::CybMLException& e) {
-		lastLoadError = tr("Wrong format of the Cyberiada grapml file:\n") + QString(e.str().c_str());
+		error = tr("Wrong format of the Cyberiada grapml file:\n") + QString(e.str().c_str());
 	} catch (const Cyberiada::Exception& e) {
-		lastLoadError = tr("Cannot load state machine graph:\n") + QString(e.str().c_str());
+		error = tr("Cannot load state machine graph:\n") + QString(e.str().c_str());
 	}
 
-	if (!lastLoadError.isEmpty()) {
+	if (!error.isEmpty()) {
 		if (new_doc) {
 			delete new_doc;
 		}
-		return false;
+		return NULL;
 	}
+	if (cache != cacheDisabled) {
+		// the cache is an optimization: the load succeeds even if it cannot be written
+		writeDocumentCache(path, new_doc, geometry);
+	}
+	return new_doc;
+}
 
+void CyberiadaSMModel::setDocument(Cyberiada::LocalDocument* new_doc, const QString& path)
+{
+	MY_ASSERT(new_doc);
+	lastLoadError.clear();
 	beginResetModel();
 	if (root) {
 		delete root;
 	}
 	root = new_doc;
+	documentPath = path;
+	rebuildIndex();
+	clearUndoHistory();
 	endResetModel();
-	return true;
 }
 
 void CyberiadaSMModel::saveDocument(bool round)
 {
-	if (root && !root->get_file_path().empty()) {
+	if (!root || !documentModified) return;
+	if (!root->get_file_path().empty()) {
 		root->save();
+	} else if (!documentPath.isEmpty()) {
+		// a document restored from the cache has no file bound; only
+		// CyberiadaML-1.0 documents with the Qt geometry are restored
+		root->save_as(documentPath.toStdString(), Cyberiada::formatCyberiada10, round);
+	} else {
+		return;
 	}
+	clearModified();
 }
 
 void CyberiadaSMModel::saveAsDocument(const QString& path, Cyberiada::DocumentFormat f, bool round)
 {
 	if (root) {
 		root->save_as(path.toStdString(), f, round);
+		documentPath = path;
+		clearModified();
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Modification tracking
+ * ----------------------------------------------------------------------------- */
+
+void CyberiadaSMModel::clearModified()
+{
+	dirtyElements.clear();
+	if (documentModified) {
+		documentModified = false;
+		emit modifiedChanged(false);
+	}
+}
+
+void CyberiadaSMModel::markDirty(const Cyberiada::Element* element)
+{
+	// the detached elements are not a part of the document anymore
+	if (!element || !elementRows.contains(element)) return;
+	dirtyElements.insert(element);
+	if (!documentModified) {
+		documentModified = true;
+		emit modifiedChanged(true);
+	}
+}
+
+void CyberiadaSMModel::markDirty(const CyberiadaSMDelta* delta)
+{
+	markDirty(delta->element);
+	if (delta->type == deltaInsert || delta->type == deltaRemove || delta->type == deltaMove) {
+		// the parents changed their children lists
+		const CyberiadaSMStructureDelta* d = static_cast<const CyberiadaSMStructureDelta*>(delta);
+		markDirty(d->old_parent);
+		markDirty(d->new_parent);
+	}
+}
+
+void CyberiadaSMModel::beginTransaction()
+{
+	transactionLevel++;
+}
+
+void CyberiadaSMModel::commitTransaction()
+{
+	MY_ASSERT(transactionLevel > 0);
+	if (--transactionLevel > 0) {
+		return;
+	}
+	if (openStep) {
+		history.push(openStep);
+		openStep = NULL;
+		emit historyChanged();
+	}
+	// the receivers may edit the model again, so detach the pending list first
+	QList<const Cyberiada::Element*> elements;
+	QSet<const Cyberiada::Element*> pending;
+	elements.swap(changedElements);
+	pending.swap(changedSet);
+	foreach(const Cyberiada::Element* element, elements) {
+		if (!pending.remove(element)) {
+			// deleted during the transaction or already reported
+			continue;
+		}
+		QModelIndex index = elementToIndex(element);
+		emit dataChanged(index, index);
+	}
+}
+
+void CyberiadaSMModel::elementChanged(const QModelIndex& index)
+{
+	invalidateBounds(indexToElement(index));
+	if (transactionLevel == 0) {
+		emit dataChanged(index, index);
+		return;
+	}
+	const Cyberiada::Element* element = indexToElement(index);
+	if (element && !changedSet.contains(element)) {
+		changedSet.insert(element);
+		changedElements.append(element);
 	}
 }
 
@@ -132,22 +267,7 @@ QVariant CyberiadaSMModel::data(const QModelIndex &index, int role) const
 				MY_ASSERT(doc);
 				return QString(doc->meta().get_string(CYBERIADA_META_NAME).c_str());
 			} else if (element->get_type() == Cyberiada::elementTransition) {
-				const Cyberiada::Transition* trans = static_cast<const Cyberiada::Transition*>(element);
-				QString id = trans->source_element_id().c_str();
-				const Cyberiada::Element* source = idToElement(id);
-				MY_ASSERT(source);
-				QString source_name = source->get_name().c_str();
-				if (source_name.isEmpty()) {
-					source_name = QString("[") + source->get_id().c_str() + "]";
-				}
-				id = trans->target_element_id().c_str();
-				const Cyberiada::Element* target = idToElement(id);
-				MY_ASSERT(target);
-				QString target_name = target->get_name().c_str();
-				if (target_name.isEmpty()) {
-					target_name = QString("[") + target->get_id().c_str() + "]";
-				}				
-				return QString(source_name + " -> " + target_name);
+				return transitionLabel(static_cast<const Cyberiada::Transition*>(element));
 			} else {
 				QString name = element->get_name().c_str();
 				if (name.isEmpty()) {
@@ -169,6 +289,130 @@ QVariant CyberiadaSMModel::data(const QModelIndex &index, int role) const
 	}
 }
 
+QString CyberiadaSMModel::transitionLabel(const Cyberiada::Transition* trans) const
+{
+	QHash<const Cyberiada::Element*, QString>::const_iterator cached = transitionLabels.find(trans);
+	if (cached != transitionLabels.end()) {
+		return cached.value();
+	}
+	const Cyberiada::Element* source = idToElement(QString(trans->source_element_id().c_str()));
+	MY_ASSERT(source);
+	QString source_name = source->get_name().c_str();
+	if (source_name.isEmpty()) {
+		source_name = QString("[") + source->get_id().c_str() + "]";
+	}
+	const Cyberiada::Element* target = idToElement(QString(trans->target_element_id().c_str()));
+	MY_ASSERT(target);
+	QString target_name = target->get_name().c_str();
+	if (target_name.isEmpty()) {
+		target_name = QString("[") + target->get_id().c_str() + "]";
+	}
+	QString label = source_name + " -> " + target_name;
+	transitionLabels.insert(trans, label);
+	if (!labelDependents.contains(source, trans)) {
+		labelDependents.insert(source, trans);
+	}
+	if (!labelDependents.contains(target, trans)) {
+		labelDependents.insert(target, trans);
+	}
+	return label;
+}
+
+void CyberiadaSMModel::invalidateTransitionLabels(const Cyberiada::Element* element)
+{
+	// the element's own label (if a transition) and the labels naming it
+	transitionLabels.remove(element);
+	QMultiHash<const Cyberiada::Element*, const Cyberiada::Element*>::iterator i = labelDependents.find(element);
+	while (i != labelDependents.end() && i.key() == element) {
+		transitionLabels.remove(i.value());
+		i = labelDependents.erase(i);
+	}
+}
+
+Cyberiada::Rect CyberiadaSMModel::elementBoundRect(const Cyberiada::Element* element) const
+{
+	MY_ASSERT(element);
+	MY_ASSERT(root);
+	QHash<const Cyberiada::Element*, Cyberiada::Rect>::const_iterator cached = boundRects.find(element);
+	if (cached != boundRects.end()) {
+		return cached.value();
+	}
+	Cyberiada::Rect r = element->get_bound_rect(*root);
+	boundRects.insert(element, r);
+	return r;
+}
+
+void CyberiadaSMModel::invalidateBounds(const Cyberiada::Element* element)
+{
+	// the parent bounds include the children
+	for (; element; element = element->get_parent()) {
+		boundRects.remove(element);
+	}
+}
+
+void CyberiadaSMModel::linkTransition(Cyberiada::Transition* trans)
+{
+	MY_ASSERT(!transitionEnds.contains(trans));
+	QString source(trans->source_element_id().c_str());
+	QString target(trans->target_element_id().c_str());
+	outgoingIndex.insert(source, trans);
+	incomingIndex.insert(target, trans);
+	transitionEnds.insert(trans, qMakePair(source, target));
+}
+
+void CyberiadaSMModel::unlinkTransition(const Cyberiada::Element* trans)
+{
+	QHash<const Cyberiada::Element*, QPair<QString, QString> >::iterator ends = transitionEnds.find(trans);
+	if (ends == transitionEnds.end()) return;
+	Cyberiada::Transition* t = static_cast<Cyberiada::Transition*>(const_cast<Cyberiada::Element*>(trans));
+	outgoingIndex.remove(ends.value().first, t);
+	incomingIndex.remove(ends.value().second, t);
+	transitionEnds.erase(ends);
+}
+
+void CyberiadaSMModel::renameTransitionEnds(const QString& old_id, const QString& new_id)
+{
+	if (old_id == new_id) return;
+	// the transitions keep following the renamed vertex
+	QList<Cyberiada::Transition*> outgoing = outgoingIndex.values(old_id);
+	QList<Cyberiada::Transition*> incoming = incomingIndex.values(old_id);
+	outgoingIndex.remove(old_id);
+	incomingIndex.remove(old_id);
+	foreach(Cyberiada::Transition* trans, outgoing) {
+		outgoingIndex.insert(new_id, trans);
+		transitionEnds[trans].first = new_id;
+	}
+	foreach(Cyberiada::Transition* trans, incoming) {
+		incomingIndex.insert(new_id, trans);
+		transitionEnds[trans].second = new_id;
+	}
+}
+
+QList<Cyberiada::Transition*> CyberiadaSMModel::outgoingTransitions(const Cyberiada::Element* vertex) const
+{
+	MY_ASSERT(vertex);
+	return outgoingIndex.values(QString(vertex->get_id().c_str()));
+}
+
+QList<Cyberiada::Transition*> CyberiadaSMModel::incomingTransitions(const Cyberiada::Element* vertex) const
+{
+	MY_ASSERT(vertex);
+	return incomingIndex.values(QString(vertex->get_id().c_str()));
+}
+
+QList<Cyberiada::Transition*> CyberiadaSMModel::elementTransitions(const Cyberiada::Element* vertex) const
+{
+	MY_ASSERT(vertex);
+	QString id(vertex->get_id().c_str());
+	QList<Cyberiada::Transition*> result = outgoingIndex.values(id);
+	foreach(Cyberiada::Transition* trans, incomingIndex.values(id)) {
+		if (transitionEnds.value(trans).first != id) {
+			result.append(trans);
+		}
+	}
+	return result;
+}
+
 QIcon CyberiadaSMModel::getElementIcon(Cyberiada::ElementType type) const
 {
 	if (icons.find(type) != icons.end()) {
@@ -202,13 +446,13 @@ bool CyberiadaSMModel::updateID(const QModelIndex& index, const QString& new_val
 		// empty id is not allowed
 		return false;
 	}
-	Cyberiada::ID new_id(new_value.toStdString());
-	if (root->find_element_by_id(new_id) != NULL) {
+	if (elementsById.contains(new_value)) {
 		// the id is already available in the document
 		return false;
 	}
-	element->set_id(new_id);
-	emit dataChanged(index, index);
+	Cyberiada::ID old_id = element->get_id();
+	setElementID(element, Cyberiada::ID(new_value.toStdString()));
+	recordDelta(new CyberiadaSMTextDelta(deltaID, element, old_id, element->get_id()));
 	return true;
 }
 
@@ -217,8 +461,11 @@ bool CyberiadaSMModel::updateTitle(const QModelIndex& index, const QString& new_
 	Cyberiada::Element* element = indexToElement(index);
 	if (!element) return false;
 	Cyberiada::Name new_name(new_value.toStdString());
+	Cyberiada::Name old_name = element->get_name();
 	element->set_name(new_name);
-	emit dataChanged(index, index);
+	invalidateTransitionLabels(element);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMTextDelta(deltaTitle, element, old_name, new_name));
 	return true;
 }
 
@@ -228,6 +475,7 @@ bool CyberiadaSMModel::updateAction(const QModelIndex& index,
 {
 	Cyberiada::Element* element = indexToElement(index);
 	if (!element) return false;
+	std::vector<Cyberiada::Action> old_actions = elementActions(element);
 	if (element->get_type() == Cyberiada::elementSimpleState || element->get_type() == Cyberiada::elementCompositeState) {
 		Cyberiada::State* state = static_cast<Cyberiada::State*>(element);
 		std::vector<Cyberiada::Action>& actions = state->get_actions();
@@ -248,7 +496,8 @@ bool CyberiadaSMModel::updateAction(const QModelIndex& index,
 	} else {
 		return false;
 	}
-	emit dataChanged(index, index);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMActionsDelta(element, old_actions, elementActions(element)));
 	return true;
 }
 
@@ -257,6 +506,7 @@ bool CyberiadaSMModel::newAction(const QModelIndex& index, Cyberiada::ActionType
 {
 	Cyberiada::Element* element = indexToElement(index);
 	if (!element) return false;
+	std::vector<Cyberiada::Action> old_actions = elementActions(element);
 	if (element->get_type() == Cyberiada::elementSimpleState || element->get_type() == Cyberiada::elementCompositeState) {
 		Cyberiada::State* state = static_cast<Cyberiada::State*>(element);
 		std::vector<Cyberiada::Action>& actions = state->get_actions();
@@ -277,7 +527,8 @@ bool CyberiadaSMModel::newAction(const QModelIndex& index, Cyberiada::ActionType
 	} else {
 		return false;
 	}
-	emit dataChanged(index, index);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMActionsDelta(element, old_actions, elementActions(element)));
 	return true;
 }
 
@@ -285,6 +536,7 @@ bool CyberiadaSMModel::deleteAction(const QModelIndex& index, int action_index)
 {
 	Cyberiada::Element* element = indexToElement(index);
 	if (!element) return false;
+	std::vector<Cyberiada::Action> old_actions = elementActions(element);
 	if (element->get_type() == Cyberiada::elementSimpleState || element->get_type() == Cyberiada::elementCompositeState) {
 		Cyberiada::State* state = static_cast<Cyberiada::State*>(element);
 		std::vector<Cyberiada::Action>& actions = state->get_actions();
@@ -301,7 +553,8 @@ bool CyberiadaSMModel::deleteAction(const QModelIndex& index, int action_index)
 	} else {
 		return false;
 	}
-	emit dataChanged(index, index);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMActionsDelta(element, old_actions, elementActions(element)));
 	return true;
 }
 
@@ -311,8 +564,10 @@ bool CyberiadaSMModel::updateGeometry(const QModelIndex& index, const Cyberiada:
 	if (!element) return false;
 	if (!element->has_point_geometry()) return false;
 	Cyberiada::Vertex* v = static_cast<Cyberiada::Vertex*>(element);
+	CyberiadaSMGeometry old_geometry = elementGeometry(element);
 	v->update_geometry(point);
-	emit dataChanged(index, index);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMGeometryDelta(element, old_geometry, elementGeometry(element)));
 	return true;
 }
 
@@ -321,6 +576,7 @@ bool CyberiadaSMModel::updateGeometry(const QModelIndex& index, const Cyberiada:
 	Cyberiada::Element* element = indexToElement(index);
     if (!element) return false;
     if (!element->has_rect_geometry()) return false;
+    CyberiadaSMGeometry old_geometry = elementGeometry(element);
     if (element->get_type() == Cyberiada::elementComment || element->get_type() == Cyberiada::elementFormalComment) {
 		Cyberiada::Comment* comment = static_cast<Cyberiada::Comment*>(element);
         comment->update_geometry(rect);
@@ -328,7 +584,8 @@ bool CyberiadaSMModel::updateGeometry(const QModelIndex& index, const Cyberiada:
 		Cyberiada::ElementCollection* ec = static_cast<Cyberiada::ElementCollection*>(element);
         ec->update_geometry(rect);
 	}
-	emit dataChanged(index, index);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMGeometryDelta(element, old_geometry, elementGeometry(element)));
 	return true;
 }
 
@@ -339,8 +596,10 @@ bool CyberiadaSMModel::updateGeometry(const QModelIndex& index, const Cyberiada:
 	if (element->get_type() != Cyberiada::elementTransition) return false;
 	Cyberiada::Transition* trans = static_cast<Cyberiada::Transition*>(element);
     // TODO
+    CyberiadaSMGeometry old_geometry = elementGeometry(element);
     trans->update(source, target);
-	emit dataChanged(index, index);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMGeometryDelta(element, old_geometry, elementGeometry(element)));
 	return true;
 }
 
@@ -351,8 +610,10 @@ bool CyberiadaSMModel::updateGeometry(const QModelIndex& index, const Cyberiada:
 	if (element->get_type() != Cyberiada::elementTransition) return false;
 	Cyberiada::Transition* trans = static_cast<Cyberiada::Transition*>(element);
 	// TODO
+    CyberiadaSMGeometry old_geometry = elementGeometry(element);
     trans->update(pl);
-	emit dataChanged(index, index);
+	elementChanged(index);
+	recordDelta(new CyberiadaSMGeometryDelta(element, old_geometry, elementGeometry(element)));
 	return true;
 }
 
@@ -363,12 +624,17 @@ bool CyberiadaSMModel::updateGeometry(const QModelIndex &index, const Cyberiada:
     if (element->get_type() != Cyberiada::elementTransition) return false;
     Cyberiada::Transition* trans = static_cast<Cyberiada::Transition*>(element);
     // TODO
-    if (root->find_element_by_id(source) == NULL || root->find_element_by_id(target) == NULL) {
+    if (idToElement(source.c_str()) == NULL || idToElement(target.c_str()) == NULL) {
         // the id isn't available in the document
         return false;
     }
+    CyberiadaSMGeometry old_geometry = elementGeometry(element);
     trans->update(source, target);
-    emit dataChanged(index, index);
+    invalidateTransitionLabels(element);
+    unlinkTransition(trans);
+    linkTransition(trans);
+    elementChanged(index);
+    recordDelta(new CyberiadaSMGeometryDelta(element, old_geometry, elementGeometry(element)));
     return true;
 }
 
@@ -391,7 +657,7 @@ bool CyberiadaSMModel::updateCommentBody(const QModelIndex& index, const QString
 	Cyberiada::Element* element = indexToElement(index);
 	if (!element) return false;
     // TODO
-	emit dataChanged(index, index);
+	elementChanged(index);
 	return true;
 }
 
@@ -401,8 +667,8 @@ bool CyberiadaSMModel::updateMetainformation(const QModelIndex& index, const QSt
 		return false;
 	}
 	QModelIndex comment_index = elementToIndex(root->get_meta_element());
-	emit dataChanged(comment_index, comment_index);
-	emit dataChanged(index, index);
+	elementChanged(comment_index);
+	elementChanged(index);
 	return true;
 }
 
@@ -412,10 +678,12 @@ Cyberiada::StateMachine *CyberiadaSMModel::newStateMachine(const Cyberiada::Stri
         root = new Cyberiada::LocalDocument();
     }
 
-    int row = rowCount(rootIndex());
-    beginInsertRows(rootIndex(), row, row);
+    int row = int(root->children_count());
+    bool visible = beginInsertChild(root, row);
     Cyberiada::StateMachine* element = root->new_state_machine(sm_name, r);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(root, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, root, row, 1));
 
     return element;
 }
@@ -428,10 +696,12 @@ Cyberiada::State *CyberiadaSMModel::newState(Cyberiada::ElementCollection *paren
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(parent));
-    beginInsertRows(elementToIndex(parent), row, row);
+    int row = int(parent->children_count());
+    bool visible = beginInsertChild(parent, row);
     Cyberiada::State* element = root->new_state(parent, state_name, a, r, region, color);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(parent, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, parent, row, 1));
 
     return element;
 }
@@ -442,10 +712,12 @@ Cyberiada::InitialPseudostate *CyberiadaSMModel::newInitial(Cyberiada::ElementCo
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(parent));
-    beginInsertRows(elementToIndex(parent), row, row);
+    int row = int(parent->children_count());
+    bool visible = beginInsertChild(parent, row);
     Cyberiada::InitialPseudostate* element = root->new_initial(parent, p);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(parent, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, parent, row, 1));
 
     return element;
 }
@@ -456,10 +728,12 @@ Cyberiada::FinalState *CyberiadaSMModel::newFinal(Cyberiada::ElementCollection *
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(parent));
-    beginInsertRows(elementToIndex(parent), row, row);
+    int row = int(parent->children_count());
+    bool visible = beginInsertChild(parent, row);
     Cyberiada::FinalState* element = root->new_final(parent, p);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(parent, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, parent, row, 1));
 
     return element;
 }
@@ -471,10 +745,12 @@ Cyberiada::ChoicePseudostate *CyberiadaSMModel::newChoice(Cyberiada::ElementColl
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(parent));
-    beginInsertRows(elementToIndex(parent), row, row);
+    int row = int(parent->children_count());
+    bool visible = beginInsertChild(parent, row);
     Cyberiada::ChoicePseudostate* element = root->new_choice(parent, r, color);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(parent, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, parent, row, 1));
 
     return element;
 }
@@ -485,10 +761,12 @@ Cyberiada::TerminatePseudostate *CyberiadaSMModel::newTerminate(Cyberiada::Eleme
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(parent));
-    beginInsertRows(elementToIndex(parent), row, row);
+    int row = int(parent->children_count());
+    bool visible = beginInsertChild(parent, row);
     Cyberiada::TerminatePseudostate* element = root->new_terminate(parent, p);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(parent, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, parent, row, 1));
 
     return element;
 }
@@ -504,10 +782,12 @@ Cyberiada::Transition *CyberiadaSMModel::newTransition(Cyberiada::StateMachine *
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(sm));
-    beginInsertRows(elementToIndex(sm), row, row);
+    int row = int(sm->children_count());
+    bool visible = beginInsertChild(sm, row);
     Cyberiada::Transition* element = root->new_transition(sm, ttype, source, target, action, pl, sp, tp, label_point, label_rect, color);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(sm, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, sm, row, 1));
 
     return element;
 }
@@ -519,10 +799,12 @@ Cyberiada::Comment *CyberiadaSMModel::newComment(Cyberiada::ElementCollection *p
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(parent));
-    beginInsertRows(elementToIndex(parent), row, row);
+    int row = int(parent->children_count());
+    bool visible = beginInsertChild(parent, row);
     Cyberiada::Comment* element = root->new_comment(parent, body, rect, color, markup);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(parent, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, parent, row, 1));
 
     return element;
 }
@@ -535,10 +817,12 @@ Cyberiada::Comment *CyberiadaSMModel::newFormalComment(Cyberiada::ElementCollect
         return nullptr;
     }
 
-    int row = rowCount(elementToIndex(parent));
-    beginInsertRows(elementToIndex(parent), row, row);
+    int row = int(parent->children_count());
+    bool visible = beginInsertChild(parent, row);
     Cyberiada::Comment* element = root->new_formal_comment(parent, body, rect, color, markup);
-    endInsertRows();
+    indexElement(element, row);
+    endInsertChild(parent, element, visible);
+    recordDelta(new CyberiadaSMStructureDelta(deltaInsert, element, NULL, -1, parent, row, 1));
 
     return element;
 }
@@ -549,10 +833,14 @@ bool CyberiadaSMModel::deleteElement(const QModelIndex &index)
     if (!child_element) return false;
     Cyberiada::ElementCollection* parent_element = dynamic_cast<Cyberiada::ElementCollection*>(child_element->get_parent());
     MY_ASSERT(parent_element);
-    int row = child_element->index();
-    beginRemoveRows(elementToIndex(parent_element), row, row);
-    parent_element->remove_element(child_element->get_id());
-    endRemoveRows();
+    int row = elementRow(child_element);
+    // the element is not freed but kept detached by the undo history
+    // (remove_element() would delete it)
+    CyberiadaSMStructureDelta* delta = new CyberiadaSMStructureDelta(deltaRemove, child_element, parent_element, row,
+                                                                     NULL, -1, subtreeSize(child_element));
+    removeSubtree(child_element);
+    delta->owns_payload = true;
+    recordDelta(delta);
     return true;
 }
 
@@ -584,11 +872,7 @@ bool CyberiadaSMModel::hasIndex(int row, int column, const QModelIndex & parent)
 	}
 	const Cyberiada::Element *parent_element = static_cast<const Cyberiada::Element*>(parent.internalPointer());
 	MY_ASSERT(parent_element);
-	if(parent_element->has_children()) {
-		return row >= 0 && row < int(parent_element->children_count());
-	} else {
-		return false;
-	}
+	return row >= 0 && row < fetchedRows(parent_element);
 }
 
 QModelIndex CyberiadaSMModel::index(int row, int column, const QModelIndex &parent) const
@@ -631,12 +915,13 @@ QModelIndex CyberiadaSMModel::parent(const QModelIndex &index) const
 		//qDebug() << "parent result: root2";		
 		return documentIndex();
 	}
-	//qDebug() << "parent result" << parent_element->index() << 0 << (void*)parent_element;
-	return createIndex(parent_element->index(), 0, (void*)parent_element);
+	//qDebug() << "parent result" << elementRow(parent_element) << 0 << (void*)parent_element;
+	return createIndex(elementRow(parent_element), 0, (void*)parent_element);
 }
 
 int CyberiadaSMModel::rowCount(const QModelIndex &parent) const
 {
+	// only the rows exposed by fetchMore() are visible
 	//qDebug() << "row count" << (void*)parent.internalPointer();
 	const Cyberiada::Element* element;
 	if (!parent.isValid()) {
@@ -651,7 +936,7 @@ int CyberiadaSMModel::rowCount(const QModelIndex &parent) const
 		element = static_cast<const Cyberiada::Element*>(parent.internalPointer());
 	}
 	MY_ASSERT(element);
-	return element->children_count();
+	return fetchedRows(element);
 }
 
 int CyberiadaSMModel::columnCount(const QModelIndex &) const
@@ -661,7 +946,36 @@ int CyberiadaSMModel::columnCount(const QModelIndex &) const
 
 bool CyberiadaSMModel::hasChildren(const QModelIndex & parent) const
 {
-	return rowCount(parent) > 0;
+	// the expand arrow is shown before the children are fetched
+	if (!parent.isValid() || parent == rootIndex()) {
+		return rowCount(parent) > 0;
+	}
+	const Cyberiada::Element* element = static_cast<const Cyberiada::Element*>(parent.internalPointer());
+	MY_ASSERT(element);
+	return element->has_children() && element->children_count() > 0;
+}
+
+bool CyberiadaSMModel::canFetchMore(const QModelIndex& parent) const
+{
+	if (!parent.isValid() || parent == rootIndex()) {
+		return false;
+	}
+	const Cyberiada::Element* element = static_cast<const Cyberiada::Element*>(parent.internalPointer());
+	MY_ASSERT(element);
+	return element->has_children() && fetchedRows(element) < int(element->children_count());
+}
+
+void CyberiadaSMModel::fetchMore(const QModelIndex& parent)
+{
+	if (!canFetchMore(parent)) {
+		return;
+	}
+	const Cyberiada::Element* element = static_cast<const Cyberiada::Element*>(parent.internalPointer());
+	int first = fetchedRows(element);
+	int last = qMin(first + MODEL_FETCH_CHUNK_SIZE, int(element->children_count())) - 1;
+	beginInsertRows(parent, first, last);
+	fetchedCounts.insert(element, last + 1);
+	endInsertRows();
 }
 
 QModelIndex CyberiadaSMModel::rootIndex() const
@@ -698,9 +1012,10 @@ QModelIndex CyberiadaSMModel::elementToIndex(const Cyberiada::Element* element)
 	if (element->is_root()) {
 		return documentIndex();
 	} else {
-		const Cyberiada::Element* parent = element->get_parent();
-        MY_ASSERT(parent);
-		return index(element->index(), 0, elementToIndex(parent));
+		// rows are cached by the structural mutators, so there is no need
+		// to walk up to the root here
+		MY_ASSERT(element->get_parent());
+		return createIndex(elementRow(element), 0, (void*)element);
 	}
 }
 
@@ -721,13 +1036,88 @@ Cyberiada::Element* CyberiadaSMModel::indexToElement(const QModelIndex& index)
 const Cyberiada::Element* CyberiadaSMModel::idToElement(const QString& id) const
 {
 	MY_ASSERT(root);
-	return root->find_element_by_id(id.toStdString());
+	return elementsById.value(id, NULL);
 }
 
 Cyberiada::Element* CyberiadaSMModel::idToElement(const QString& id)
 {
 	MY_ASSERT(root);
-	return root->find_element_by_id(id.toStdString());
+	return elementsById.value(id, NULL);
+}
+
+void CyberiadaSMModel::rebuildIndex()
+{
+	elementsById.clear();
+	elementRows.clear();
+	changedElements.clear();
+	changedSet.clear();
+	fetchedCounts.clear();
+	transitionLabels.clear();
+	labelDependents.clear();
+	boundRects.clear();
+	outgoingIndex.clear();
+	incomingIndex.clear();
+	transitionEnds.clear();
+	clearModified();
+	if (root) {
+		indexElement(root, 0);
+	}
+}
+
+void CyberiadaSMModel::indexElement(Cyberiada::Element* element, int row)
+{
+	MY_ASSERT(element);
+	elementsById.insert(QString(element->get_id().c_str()), element);
+	elementRows.insert(element, row);
+	if (element->get_type() == Cyberiada::elementTransition) {
+		linkTransition(static_cast<Cyberiada::Transition*>(element));
+	}
+	if (element->has_children()) {
+		Cyberiada::ElementCollection* collection = static_cast<Cyberiada::ElementCollection*>(element);
+		const Cyberiada::ElementList& children = collection->get_children();
+		int child_row = 0;
+		for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++, child_row++) {
+			indexElement(*i, child_row);
+		}
+	}
+}
+
+void CyberiadaSMModel::unindexElement(const Cyberiada::Element* element)
+{
+	MY_ASSERT(element);
+	elementsById.remove(QString(element->get_id().c_str()));
+	elementRows.remove(element);
+	changedSet.remove(element);
+	dirtyElements.remove(element);
+	fetchedCounts.remove(element);
+	invalidateTransitionLabels(element);
+	unlinkTransition(element);
+	boundRects.remove(element);
+	if (element->has_children()) {
+		const Cyberiada::ElementCollection* collection = static_cast<const Cyberiada::ElementCollection*>(element);
+		const Cyberiada::ElementList& children = collection->get_children();
+		for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+			unindexElement(*i);
+		}
+	}
+}
+
+void CyberiadaSMModel::reindexRows(const Cyberiada::ElementCollection* collection, int from_row)
+{
+	MY_ASSERT(collection);
+	const Cyberiada::ElementList& children = collection->get_children();
+	for (int row = from_row; row < int(children.size()); row++) {
+		elementRows.insert(children.at(size_t(row)), row);
+	}
+}
+
+int CyberiadaSMModel::elementRow(const Cyberiada::Element* element) const
+{
+	QHash<const Cyberiada::Element*, int>::const_iterator i = elementRows.find(element);
+	if (i != elementRows.end()) {
+		return i.value();
+	}
+	return int(element->index());
 }
 
 const Cyberiada::LocalDocument* CyberiadaSMModel::rootDocument() const
@@ -801,7 +1191,6 @@ Qt::DropActions CyberiadaSMModel::supportedDropActions() const
 void CyberiadaSMModel::move(Cyberiada::Element* element, Cyberiada::ElementCollection* target_parent)
 {
     QModelIndex srcindex = elementToIndex(element);
-	QModelIndex parentindex = parent(srcindex);	
 	QModelIndex dstindex;
 	
     if (target_parent != NULL) {
@@ -815,33 +1204,171 @@ void CyberiadaSMModel::move(Cyberiada::Element* element, Cyberiada::ElementColle
 	MY_ASSERT(srcindex.isValid());
 
 	int remove_index = srcindex.row();
-	int add_index = rowCount(dstindex);
+	int add_index = target_parent ? int(target_parent->children_count()) : 0;
 
     Cyberiada::ElementCollection* source_parent = dynamic_cast<Cyberiada::ElementCollection*>(element->get_parent());
 
-    if (target_parent == NULL || source_parent == NULL) {
+    if (target_parent == NULL || source_parent == NULL || source_parent == target_parent) {
 		return;
 	}
 
-    // remove_element() frees the original, so deep-copy the element into the
-    // new parent first and remove the original afterwards
-    Cyberiada::Element* copied = element->copy(target_parent);
+    if (relinkSubtree(element, target_parent, add_index)) {
+        recordDelta(new CyberiadaSMStructureDelta(deltaMove, element, source_parent, remove_index,
+                                                  target_parent, add_index, 1));
+    }
+}
+
+bool CyberiadaSMModel::relinkSubtree(Cyberiada::Element* element, Cyberiada::ElementCollection* parent_element, int row)
+{
+	Cyberiada::ElementCollection* source_parent = static_cast<Cyberiada::ElementCollection*>(element->get_parent());
+	MY_ASSERT(source_parent);
+	int source_row = elementRow(element);
+	// refuses to move the element into its own subtree
+	for (const Cyberiada::Element* e = parent_element; e; e = e->get_parent()) {
+		if (e == element) {
+			return false;
+		}
+	}
+	// the rows not fetched yet are moved silently
+	bool source_visible = source_row < fetchedRows(source_parent);
+	bool target_visible = isInsertVisible(parent_element, row);
+	if (source_visible && target_visible) {
+		if (!beginMoveRows(elementToIndex(source_parent), source_row, source_row, elementToIndex(parent_element), row)) {
+			return false;
+		}
+	} else if (source_visible) {
+		beginRemoveRows(elementToIndex(source_parent), source_row, source_row);
+	} else if (target_visible) {
+		beginInsertRows(elementToIndex(parent_element), row, row);
+	}
+	// relink the element itself: pointers, scene items and persistent indexes
+	// of the whole subtree stay valid, only the sibling rows are renumbered
+	detachElement(element);
+	attachElement(element, parent_element, row);
+	reindexRows(source_parent, source_row);
+	reindexRows(parent_element, row);
+	if (source_visible) {
+		fetchedCounts[source_parent]--;
+	}
+	if (target_visible) {
+		fetchedCounts[parent_element]++;
+	}
+	if (source_visible && target_visible) {
+		endMoveRows();
+	} else if (source_visible) {
+		endRemoveRows();
+	} else if (target_visible) {
+		endInsertRows();
+	}
+	emit elementMoved(element);
+
+	elementChanged(elementToIndex(element));
+	// use in case scene::updateItemsRecursively is not used in scene::slotModelDataChanged
+	elementChanged(elementToIndex(parent_element));
+	elementChanged(elementToIndex(source_parent));
+	return true;
+}
+
+void CyberiadaSMModel::insertSubtree(Cyberiada::Element* element, Cyberiada::ElementCollection* parent_element, int row)
+{
+	bool visible = beginInsertChild(parent_element, row);
+	attachElement(element, parent_element, row);
+	indexElement(element, row);
+	reindexRows(parent_element, row + 1);
+	endInsertChild(parent_element, element, visible);
+}
+
+void CyberiadaSMModel::removeSubtree(Cyberiada::Element* element)
+{
+	Cyberiada::ElementCollection* parent_element = static_cast<Cyberiada::ElementCollection*>(element->get_parent());
+	MY_ASSERT(parent_element);
+	int row = elementRow(element);
+	bool visible = row < fetchedRows(parent_element);
+	emit elementAboutToBeRemoved(element);
+	if (visible) {
+		beginRemoveRows(elementToIndex(parent_element), row, row);
+	}
+	unindexElement(element);
+	detachElement(element);
+	reindexRows(parent_element, row);
+	if (visible) {
+		fetchedCounts[parent_element]--;
+		endRemoveRows();
+	}
+}
+
+int CyberiadaSMModel::fetchedRows(const Cyberiada::Element* element) const
+{
+	return fetchedCounts.value(element, 0);
+}
+
+bool CyberiadaSMModel::isInsertVisible(const Cyberiada::ElementCollection* parent_element, int row) const
+{
+	// a row appended to a fully fetched parent is exposed right away,
+	// the rows past the fetched ones wait for fetchMore()
+	int fetched = fetchedRows(parent_element);
+	return row < fetched || fetched == int(parent_element->children_count());
+}
+
+bool CyberiadaSMModel::beginInsertChild(Cyberiada::ElementCollection* parent_element, int row)
+{
+	if (!isInsertVisible(parent_element, row)) {
+		return false;
+	}
+	beginInsertRows(elementToIndex(parent_element), row, row);
+	return true;
+}
+
+void CyberiadaSMModel::endInsertChild(Cyberiada::ElementCollection* parent_element, Cyberiada::Element* element, bool visible)
+{
+	// a new child of the parent (the new* mutators and the undo inserts)
+	invalidateBounds(parent_element);
+	if (visible) {
+		fetchedCounts[parent_element]++;
+		endInsertRows();
+	}
+	// the row signals skip the rows not fetched yet, the scene needs them all
+	emit elementInserted(element);
+}
 
-	beginRemoveRows(parentindex, remove_index, remove_index);
-    source_parent->remove_element(element->get_id());
-	endRemoveRows();
+size_t CyberiadaSMModel::subtreeSize(const Cyberiada::Element* element)
+{
+	size_t result = 1;
+	if (element->has_children()) {
+		const Cyberiada::ElementList& children = static_cast<const Cyberiada::ElementCollection*>(element)->get_children();
+		for (Cyberiada::ElementList::const_iterator i = children.begin(); i != children.end(); i++) {
+			result += subtreeSize(*i);
+		}
+	}
+	return result;
+}
 
-	beginInsertRows(dstindex, add_index, add_index);
-    target_parent->add_element(copied);
-    endInsertRows();
+void CyberiadaSMModel::detachElement(Cyberiada::Element* element)
+{
+	// the library has no way to unlink a child without freeing it
+	// (remove_element() deletes the element), so the sibling list is
+	// edited directly
+	Cyberiada::ElementCollection* parent_element = static_cast<Cyberiada::ElementCollection*>(element->get_parent());
+	MY_ASSERT(parent_element);
+	invalidateBounds(parent_element);
+	Cyberiada::ElementList& children = const_cast<Cyberiada::ElementList&>(parent_element->get_children());
+	Cyberiada::ElementList::iterator i = std::find(children.begin(), children.end(), element);
+	MY_ASSERT(i != children.end());
+	children.erase(i);
+}
 
-    QModelIndex newIndex = elementToIndex(copied);
-    emit dataChanged(newIndex, newIndex);
-    // use in case scene::updateItemsRecursively is not used in scene::slotModelDataChanged
-    QModelIndex newTargetIndex = elementToIndex(target_parent);
-    QModelIndex newSourceIndex = elementToIndex(source_parent);
-    emit dataChanged(newTargetIndex, newTargetIndex);
-    emit dataChanged(newSourceIndex, newSourceIndex);
+void CyberiadaSMModel::attachElement(Cyberiada::Element* element, Cyberiada::ElementCollection* parent_element, int row)
+{
+	MY_ASSERT(parent_element);
+	int last_row = int(parent_element->children_count());
+	MY_ASSERT(row >= 0 && row <= last_row);
+	element->set_parent(parent_element);
+	parent_element->add_element(element);
+	invalidateBounds(parent_element);
+	if (row < last_row) {
+		Cyberiada::ElementList& children = const_cast<Cyberiada::ElementList&>(parent_element->get_children());
+		std::rotate(children.begin() + row, children.end() - 1, children.end());
+	}
 }
 
 bool CyberiadaSMModel::dropMimeData(const QMimeData *data,
@@ -906,3 +1433,231 @@ QMimeData* CyberiadaSMModel::mimeData(const QModelIndexList &indexes) const
 	mimeData->setData(cyberiadaStateMimeType, encodedData);	
 	return mimeData;
 }
+
+/* -----------------------------------------------------------------------------
+ * Undo/redo
+ * ----------------------------------------------------------------------------- */
+
+bool CyberiadaSMModel::undo()
+{
+	if (!root || transactionLevel > 0) return false;
+	CyberiadaSMUndoStep* step = history.undo();
+	if (!step) return false;
+	applyStep(step, true);
+	return true;
+}
+
+bool CyberiadaSMModel::redo()
+{
+	if (!root || transactionLevel > 0) return false;
+	CyberiadaSMUndoStep* step = history.redo();
+	if (!step) return false;
+	applyStep(step, false);
+	return true;
+}
+
+void CyberiadaSMModel::beginContinuousEdit()
+{
+	// a no-op while the edit is going on: the scene calls it on every drag move
+	continuousEdit = true;
+}
+
+void CyberiadaSMModel::endContinuousEdit()
+{
+	// the next edit, even a continuous one, starts a new step
+	continuousEdit = false;
+	history.seal();
+}
+
+void CyberiadaSMModel::clearUndoHistory()
+{
+	if (openStep) {
+		delete openStep;
+		openStep = NULL;
+	}
+	history.clear();
+	emit historyChanged();
+}
+
+void CyberiadaSMModel::setUndoBudget(size_t bytes)
+{
+	history.setBudget(bytes);
+	emit historyChanged();
+}
+
+void CyberiadaSMModel::recordDelta(CyberiadaSMDelta* delta)
+{
+	markDirty(delta);
+	if (replaying) {
+		// the receivers of the undo/redo notifications are not recorded
+		delete delta;
+		return;
+	}
+	if (transactionLevel > 0) {
+		if (!openStep) {
+			openStep = new CyberiadaSMUndoStep(continuousEdit);
+		}
+		openStep->add(delta);
+		return;
+	}
+	CyberiadaSMUndoStep* step = new CyberiadaSMUndoStep(continuousEdit);
+	step->add(delta);
+	history.push(step);
+	emit historyChanged();
+}
+
+void CyberiadaSMModel::applyStep(CyberiadaSMUndoStep* step, bool undo)
+{
+	replaying = true;
+	beginTransaction();
+	if (undo) {
+		for (int i = step->deltas.size() - 1; i >= 0; i--) {
+			applyDelta(step->deltas.at(i), true);
+			markDirty(step->deltas.at(i));
+		}
+	} else {
+		for (int i = 0; i < step->deltas.size(); i++) {
+			applyDelta(step->deltas.at(i), false);
+			markDirty(step->deltas.at(i));
+		}
+	}
+	commitTransaction();
+	replaying = false;
+	// the removed subtrees are owned by the step now, the restored ones are not
+	history.recount(step);
+	emit historyChanged();
+}
+
+void CyberiadaSMModel::applyDelta(CyberiadaSMDelta* delta, bool undo)
+{
+	Cyberiada::Element* element = delta->element;
+	switch (delta->type) {
+	case deltaGeometry: {
+		CyberiadaSMGeometryDelta* d = static_cast<CyberiadaSMGeometryDelta*>(delta);
+		setElementGeometry(element, undo ? d->old_geometry : d->new_geometry);
+		break;
+	}
+	case deltaTitle: {
+		CyberiadaSMTextDelta* d = static_cast<CyberiadaSMTextDelta*>(delta);
+		element->set_name(undo ? d->old_value : d->new_value);
+		invalidateTransitionLabels(element);
+		elementChanged(elementToIndex(element));
+		break;
+	}
+	case deltaID: {
+		CyberiadaSMTextDelta* d = static_cast<CyberiadaSMTextDelta*>(delta);
+		setElementID(element, undo ? d->old_value : d->new_value);
+		break;
+	}
+	case deltaActions: {
+		CyberiadaSMActionsDelta* d = static_cast<CyberiadaSMActionsDelta*>(delta);
+		setElementActions(element, undo ? d->old_actions : d->new_actions);
+		break;
+	}
+	case deltaInsert:
+	case deltaRemove: {
+		CyberiadaSMStructureDelta* d = static_cast<CyberiadaSMStructureDelta*>(delta);
+		// undoing an insertion removes the subtree and vice versa
+		bool insert = (delta->type == deltaInsert) != undo;
+		if (insert) {
+			if (delta->type == deltaInsert) {
+				insertSubtree(element, d->new_parent, d->new_row);
+			} else {
+				insertSubtree(element, d->old_parent, d->old_row);
+			}
+			d->owns_payload = false;
+		} else {
+			removeSubtree(element);
+			d->owns_payload = true;
+		}
+		break;
+	}
+	case deltaMove: {
+		CyberiadaSMStructureDelta* d = static_cast<CyberiadaSMStructureDelta*>(delta);
+		if (undo) {
+			relinkSubtree(element, d->old_parent, d->old_row);
+		} else {
+			relinkSubtree(element, d->new_parent, d->new_row);
+		}
+		break;
+	}
+	}
+}
+
+CyberiadaSMGeometry CyberiadaSMModel::elementGeometry(const Cyberiada::Element* element) const
+{
+	CyberiadaSMGeometry geometry;
+	if (element->get_type() == Cyberiada::elementTransition) {
+		const Cyberiada::Transition* trans = static_cast<const Cyberiada::Transition*>(element);
+		geometry.source_id = trans->source_element_id();
+		geometry.target_id = trans->target_element_id();
+		geometry.source_point = trans->get_source_point();
+		geometry.target_point = trans->get_target_point();
+		geometry.polyline = trans->get_geometry_polyline();
+	} else if (element->has_point_geometry()) {
+		Cyberiada::Rect r = element->get_bound_rect(*root);
+		geometry.point = Cyberiada::Point(r.x, r.y);
+	} else if (element->has_rect_geometry()) {
+		if (element->get_type() == Cyberiada::elementComment || element->get_type() == Cyberiada::elementFormalComment) {
+			geometry.rect = static_cast<const Cyberiada::Comment*>(element)->get_geometry_rect();
+		} else {
+			geometry.rect = static_cast<const Cyberiada::ElementCollection*>(element)->get_geometry_rect();
+		}
+	}
+	return geometry;
+}
+
+void CyberiadaSMModel::setElementGeometry(Cyberiada::Element* element, const CyberiadaSMGeometry& geometry)
+{
+	if (element->get_type() == Cyberiada::elementTransition) {
+		Cyberiada::Transition* trans = static_cast<Cyberiada::Transition*>(element);
+		trans->update(geometry.source_id, geometry.target_id);
+		trans->update(geometry.source_point, geometry.target_point);
+		trans->update(geometry.polyline);
+		invalidateTransitionLabels(element);
+		unlinkTransition(trans);
+		linkTransition(trans);
+	} else if (element->has_point_geometry()) {
+		static_cast<Cyberiada::Vertex*>(element)->update_geometry(geometry.point);
+	} else if (element->has_rect_geometry()) {
+		if (element->get_type() == Cyberiada::elementComment || element->get_type() == Cyberiada::elementFormalComment) {
+			static_cast<Cyberiada::Comment*>(element)->update_geometry(geometry.rect);
+		} else {
+			static_cast<Cyberiada::ElementCollection*>(element)->update_geometry(geometry.rect);
+		}
+	}
+	elementChanged(elementToIndex(element));
+}
+
+std::vector<Cyberiada::Action> CyberiadaSMModel::elementActions(const Cyberiada::Element* element) const
+{
+	std::vector<Cyberiada::Action> actions;
+	if (element->get_type() == Cyberiada::elementSimpleState || element->get_type() == Cyberiada::elementCompositeState) {
+		actions = static_cast<const Cyberiada::State*>(element)->get_actions();
+	} else if (element->get_type() == Cyberiada::elementTransition) {
+		actions.push_back(static_cast<const Cyberiada::Transition*>(element)->get_action());
+	}
+	return actions;
+}
+
+void CyberiadaSMModel::setElementActions(Cyberiada::Element* element, const std::vector<Cyberiada::Action>& actions)
+{
+	if (element->get_type() == Cyberiada::elementSimpleState || element->get_type() == Cyberiada::elementCompositeState) {
+		static_cast<Cyberiada::State*>(element)->get_actions() = actions;
+	} else if (element->get_type() == Cyberiada::elementTransition && !actions.empty()) {
+		static_cast<Cyberiada::Transition*>(element)->get_action() = actions.front();
+	}
+	elementChanged(elementToIndex(element));
+}
+
+void CyberiadaSMModel::setElementID(Cyberiada::Element* element, const Cyberiada::ID& id)
+{
+	QString old_id(element->get_id().c_str());
+	elementsById.remove(old_id);
+	element->set_id(id);
+	elementsById.insert(QString(id.c_str()), element);
+	renameTransitionEnds(old_id, QString(id.c_str()));
+	invalidateTransitionLabels(element);
+	emit elementIdChanged(old_id, QString(id.c_str()));
+	elementChanged(elementToIndex(element));
+}
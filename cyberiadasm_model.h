@@ -26,9 +26,18 @@
 
 #include <QAbstractItemModel>
 #include <QIcon>
+#include <QHash>
+#include <QSet>
+#include <QList>
 #include <QDateTime>
 #include <cyberiada/cyberiadamlpp.h>
 
+#include "cyberiadasm_model_history.h"
+#include "cyberiadasm_document_cache.h"
+
+// the number of child rows exposed to the views by a single fetchMore()
+#define MODEL_FETCH_CHUNK_SIZE 64
+
 class CyberiadaSMModel: public QAbstractItemModel {
 Q_OBJECT
 
@@ -39,11 +48,50 @@ public:
 	// CORE FUNCTIONALITY
 	void                                reset();
     // void                                createDocument();
-	bool                                loadDocument(const QString& path, bool reconstruct = false, bool reconsruct_sm = false);
+	bool                                loadDocument(const QString& path, bool reconstruct = false, bool reconsruct_sm = false,
+													 CyberiadaSMCacheMode cache = cacheDisabled);
 	const QString&                      loadError() const { return lastLoadError; }
+	// parse the document without touching the model (safe to call from a worker thread);
+	// returns NULL and sets the error on failure
+	static Cyberiada::LocalDocument*    parseDocument(const QString& path, bool reconstruct, bool reconstruct_sm,
+													  QString& error, CyberiadaSMCacheMode cache = cacheDisabled);
+	// take the ownership of the parsed document and swap it in with a single model reset
+	void                                setDocument(Cyberiada::LocalDocument* new_doc, const QString& path = QString());
+	// the path the document was loaded from or last saved to
+	const QString&                      filePath() const { return documentPath; }
 	void                                saveDocument(bool round = false);
 	void                                saveAsDocument(const QString& path, Cyberiada::DocumentFormat f, bool round = false);
 
+	// MODIFICATIONS
+	// the elements changed since the document was loaded or saved (the parents
+	// of the inserted, removed and moved elements included); save is a no-op
+	// for an unmodified document
+	bool                                isModified() const { return documentModified; }
+	const QSet<const Cyberiada::Element*>& modifiedElements() const { return dirtyElements; }
+	void                                clearModified();
+
+	// TRANSACTIONS
+	// dataChanged() of the elements touched between begin & commit is emitted
+	// once per element at the outermost commit; transactions can be nested
+	void                                beginTransaction();
+	void                                commitTransaction();
+	bool                                inTransaction() const { return transactionLevel > 0; }
+
+	// UNDO/REDO
+	// every edit is recorded as an inverse delta; the edits of a transaction
+	// form one step; the geometry steps of a continuous edit (a drag) are
+	// merged into one step, which is sealed when the edit ends
+	bool                                canUndo() const { return history.canUndo(); }
+	bool                                canRedo() const { return history.canRedo(); }
+	bool                                undo();
+	bool                                redo();
+	void                                beginContinuousEdit();
+	void                                endContinuousEdit();
+	bool                                inContinuousEdit() const { return continuousEdit; }
+	void                                clearUndoHistory();
+	void                                setUndoBudget(size_t bytes);
+	size_t                              undoBudget() const { return history.budget(); }
+
 	// DATA REPRESENTATION
 	QVariant                            data(const QModelIndex& index, int role) const;	
 	Qt::ItemFlags                       flags(const QModelIndex& index) const;
@@ -53,6 +101,8 @@ public:
 	int                                 rowCount(const QModelIndex& parent = QModelIndex()) const;
 	int                                 columnCount(const QModelIndex& parent = QModelIndex()) const;
 	bool                                hasChildren(const QModelIndex& parent = QModelIndex()) const;
+	bool                                canFetchMore(const QModelIndex& parent) const;
+	void                                fetchMore(const QModelIndex& parent);
 	QIcon                               getIndexIcon(const QModelIndex& index) const;
 	QIcon                               getElementIcon(Cyberiada::ElementType type) const;
 	
@@ -134,15 +184,109 @@ public:
 	Cyberiada::Element*                 indexToElement(const QModelIndex& index);
 	const Cyberiada::Element*           idToElement(const QString& id) const;
 	Cyberiada::Element*                 idToElement(const QString& id);
+
+	// BOUNDS
+	// the element bound rect (Element::get_bound_rect) cached per element; an
+	// edit drops the cached rects of the element and its ancestors only, so
+	// it is meant for the containers (a moved parent does not refresh the
+	// rects of its descendants)
+	Cyberiada::Rect                     elementBoundRect(const Cyberiada::Element* element) const;
+
+	// TRANSITION ADJACENCY
+	// the transitions leaving / entering the vertex with the given id; a
+	// lookup costs the vertex degree, not the document size
+	QList<Cyberiada::Transition*>       outgoingTransitions(const Cyberiada::Element* vertex) const;
+	QList<Cyberiada::Transition*>       incomingTransitions(const Cyberiada::Element* vertex) const;
+	// both directions, a self-loop is listed once
+	QList<Cyberiada::Transition*>       elementTransitions(const Cyberiada::Element* vertex) const;
 	
 signals:
     void                                modelAboutToBeReset();
 	void                                modelReset();
+	void                                historyChanged();
+	void                                modifiedChanged(bool modified);
+	// the structure changes, emitted for every element regardless of the
+	// fetched rows; the element is still indexed when it is about to be removed
+	void                                elementInserted(Cyberiada::Element* element);
+	void                                elementAboutToBeRemoved(Cyberiada::Element* element);
+	void                                elementMoved(Cyberiada::Element* element);
+	// the element has been re-indexed by its new id (an edit or its undo/redo)
+	void                                elementIdChanged(const QString& old_id, const QString& new_id);
 
 private:
 	void                                move(Cyberiada::Element* element, Cyberiada::ElementCollection* target_parent);
+	void                                detachElement(Cyberiada::Element* element);
+	void                                attachElement(Cyberiada::Element* element, Cyberiada::ElementCollection* parent_element, int row);
+
+	void                                elementChanged(const QModelIndex& index);
+
+	// STRUCTURE
+	void                                insertSubtree(Cyberiada::Element* element, Cyberiada::ElementCollection* parent_element, int row);
+	void                                removeSubtree(Cyberiada::Element* element);
+	bool                                relinkSubtree(Cyberiada::Element* element, Cyberiada::ElementCollection* parent_element, int row);
+	static size_t                       subtreeSize(const Cyberiada::Element* element);
+
+	// LAZY ROWS
+	int                                 fetchedRows(const Cyberiada::Element* element) const;
+	bool                                isInsertVisible(const Cyberiada::ElementCollection* parent_element, int row) const;
+	bool                                beginInsertChild(Cyberiada::ElementCollection* parent_element, int row);
+	void                                endInsertChild(Cyberiada::ElementCollection* parent_element, Cyberiada::Element* element, bool visible);
+
+	void                                markDirty(const Cyberiada::Element* element);
+	void                                markDirty(const CyberiadaSMDelta* delta);
+
+	// UNDO/REDO
+	void                                recordDelta(CyberiadaSMDelta* delta);
+	void                                applyStep(CyberiadaSMUndoStep* step, bool undo);
+	void                                applyDelta(CyberiadaSMDelta* delta, bool undo);
+	CyberiadaSMGeometry                 elementGeometry(const Cyberiada::Element* element) const;
+	void                                setElementGeometry(Cyberiada::Element* element, const CyberiadaSMGeometry& geometry);
+	std::vector<Cyberiada::Action>      elementActions(const Cyberiada::Element* element) const;
+	void                                setElementActions(Cyberiada::Element* element, const std::vector<Cyberiada::Action>& actions);
+	void                                setElementID(Cyberiada::Element* element, const Cyberiada::ID& id);
+
+	// TRANSITION LABELS
+	// "source -> target" is cached per transition until an endpoint is renamed
+	// or the transition is reconnected
+	QString                             transitionLabel(const Cyberiada::Transition* trans) const;
+	void                                invalidateTransitionLabels(const Cyberiada::Element* element);
+
+	void                                invalidateBounds(const Cyberiada::Element* element);
+
+	// TRANSITION ADJACENCY
+	// keyed by the endpoint ids the transition was linked with, so the index
+	// survives the vertices being removed and re-inserted by undo/redo
+	void                                linkTransition(Cyberiada::Transition* trans);
+	void                                unlinkTransition(const Cyberiada::Element* trans);
+	void                                renameTransitionEnds(const QString& old_id, const QString& new_id);
+
+	// ID & ROW INDEX
+	void                                rebuildIndex();
+	void                                indexElement(Cyberiada::Element* element, int row);
+	void                                unindexElement(const Cyberiada::Element* element);
+	void                                reindexRows(const Cyberiada::ElementCollection* collection, int from_row = 0);
+	int                                 elementRow(const Cyberiada::Element* element) const;
 	
 	Cyberiada::LocalDocument*           root;
+	QString                             documentPath;
+	QHash<QString, Cyberiada::Element*> elementsById;
+	QHash<const Cyberiada::Element*, int> elementRows;
+	QHash<const Cyberiada::Element*, int> fetchedCounts;
+	mutable QHash<const Cyberiada::Element*, QString> transitionLabels;
+	mutable QMultiHash<const Cyberiada::Element*, const Cyberiada::Element*> labelDependents;
+	mutable QHash<const Cyberiada::Element*, Cyberiada::Rect> boundRects;
+	QMultiHash<QString, Cyberiada::Transition*> outgoingIndex;
+	QMultiHash<QString, Cyberiada::Transition*> incomingIndex;
+	QHash<const Cyberiada::Element*, QPair<QString, QString> > transitionEnds;
+	int                                 transactionLevel;
+	QList<const Cyberiada::Element*>    changedElements;
+	QSet<const Cyberiada::Element*>     changedSet;
+	CyberiadaSMHistory                  history;
+	CyberiadaSMUndoStep*                openStep;
+	bool                                continuousEdit;
+	bool                                replaying;
+	bool                                documentModified;
+	QSet<const Cyberiada::Element*>     dirtyElements;
 	QString                             lastLoadError;
 	QString							   	cyberiadaStateMimeType;
 	QIcon                              	emptyIcon;
@@ -0,0 +1,253 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ *
+ * The State Machine Model undo/redo history implementation
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#include "cyberiadasm_model_history.h"
+#include "myassert.h"
+
+static size_t geometryBytes(const CyberiadaSMGeometry& g)
+{
+	return g.polyline.capacity() * sizeof(Cyberiada::Point) + g.source_id.capacity() + g.target_id.capacity();
+}
+
+static size_t actionsBytes(const std::vector<Cyberiada::Action>& actions)
+{
+	size_t result = actions.capacity() * sizeof(Cyberiada::Action);
+	for (std::vector<Cyberiada::Action>::const_iterator i = actions.begin(); i != actions.end(); i++) {
+		result += i->get_trigger().size() + i->get_guard().size() + i->get_behavior().size();
+	}
+	return result;
+}
+
+size_t CyberiadaSMGeometryDelta::bytes() const
+{
+	return sizeof(*this) + geometryBytes(old_geometry) + geometryBytes(new_geometry);
+}
+
+size_t CyberiadaSMTextDelta::bytes() const
+{
+	return sizeof(*this) + old_value.capacity() + new_value.capacity();
+}
+
+size_t CyberiadaSMActionsDelta::bytes() const
+{
+	return sizeof(*this) + actionsBytes(old_actions) + actionsBytes(new_actions);
+}
+
+CyberiadaSMStructureDelta::CyberiadaSMStructureDelta(CyberiadaSMDeltaType t, Cyberiada::Element* e,
+													 Cyberiada::ElementCollection* old_p, int old_r,
+													 Cyberiada::ElementCollection* new_p, int new_r,
+													 size_t subtree_size):
+	CyberiadaSMDelta(t, e), old_parent(old_p), old_row(old_r), new_parent(new_p), new_row(new_r),
+	payload_elements(subtree_size), owns_payload(false)
+{
+}
+
+CyberiadaSMStructureDelta::~CyberiadaSMStructureDelta()
+{
+	if (owns_payload && element) {
+		delete element;
+	}
+}
+
+size_t CyberiadaSMStructureDelta::bytes() const
+{
+	// a subtree linked into the document is not charged to the history
+	if (type == deltaMove || !owns_payload) {
+		return sizeof(*this);
+	}
+	return sizeof(*this) + payload_elements * UNDO_ELEMENT_ESTIMATED_SIZE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Undo Step
+ * ----------------------------------------------------------------------------- */
+
+CyberiadaSMUndoStep::~CyberiadaSMUndoStep()
+{
+	// free the payloads in reverse order: a later delta may own an element
+	// removed from the subtree of an earlier one
+	for (int i = deltas.size() - 1; i >= 0; i--) {
+		delete deltas.at(i);
+	}
+}
+
+void CyberiadaSMUndoStep::add(CyberiadaSMDelta* delta)
+{
+	MY_ASSERT(delta);
+	deltas.append(delta);
+	bytes += delta->bytes();
+}
+
+bool CyberiadaSMUndoStep::isGeometryOnly() const
+{
+	foreach(const CyberiadaSMDelta* delta, deltas) {
+		if (delta->type != deltaGeometry) {
+			return false;
+		}
+	}
+	return !deltas.isEmpty();
+}
+
+bool CyberiadaSMUndoStep::merge(CyberiadaSMUndoStep* next)
+{
+	if (sealed || !continuous || !next->continuous || !isGeometryOnly() || !next->isGeometryOnly()) {
+		return false;
+	}
+	// a frame may change an element several times (a resize cascade), so
+	// every delta is merged into the latest one of its element: redo applies
+	// the deltas in order and the latest geometry has to be the last one
+	foreach(CyberiadaSMDelta* delta, next->deltas) {
+		CyberiadaSMGeometryDelta* target = NULL;
+		for (int i = deltas.size() - 1; i >= 0; i--) {
+			if (deltas.at(i)->element == delta->element) {
+				target = static_cast<CyberiadaSMGeometryDelta*>(deltas.at(i));
+				break;
+			}
+		}
+		if (target) {
+			target->new_geometry = static_cast<CyberiadaSMGeometryDelta*>(delta)->new_geometry;
+			delete delta;
+		} else {
+			// the element joined the drag in this frame
+			deltas.append(delta);
+		}
+	}
+	next->deltas.clear();
+	next->bytes = 0;
+	recount();
+	return true;
+}
+
+void CyberiadaSMUndoStep::recount()
+{
+	bytes = 0;
+	foreach(const CyberiadaSMDelta* delta, deltas) {
+		bytes += delta->bytes();
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * History
+ * ----------------------------------------------------------------------------- */
+
+CyberiadaSMHistory::CyberiadaSMHistory():
+	bytes(0), maxBytes(DEFAULT_UNDO_BUDGET)
+{
+}
+
+CyberiadaSMHistory::~CyberiadaSMHistory()
+{
+	clear();
+}
+
+void CyberiadaSMHistory::clear()
+{
+	clearRedo();
+	while (!undoSteps.isEmpty()) {
+		delete undoSteps.takeLast();
+	}
+	bytes = 0;
+}
+
+void CyberiadaSMHistory::clearRedo()
+{
+	// the newest steps first: they may refer to elements inserted by the older ones
+	while (!redoSteps.isEmpty()) {
+		CyberiadaSMUndoStep* step = redoSteps.takeLast();
+		bytes -= step->bytes;
+		delete step;
+	}
+}
+
+void CyberiadaSMHistory::push(CyberiadaSMUndoStep* step)
+{
+	MY_ASSERT(step);
+	clearRedo();
+	if (!undoSteps.isEmpty()) {
+		CyberiadaSMUndoStep* top = undoSteps.last();
+		size_t top_bytes = top->bytes;
+		if (top->merge(step)) {
+			bytes = bytes - top_bytes + top->bytes;
+			delete step;
+			enforceBudget();
+			return;
+		}
+	}
+	undoSteps.append(step);
+	bytes += step->bytes;
+	enforceBudget();
+}
+
+void CyberiadaSMHistory::seal()
+{
+	if (!undoSteps.isEmpty()) {
+		undoSteps.last()->sealed = true;
+	}
+}
+
+CyberiadaSMUndoStep* CyberiadaSMHistory::undo()
+{
+	if (undoSteps.isEmpty()) return NULL;
+	CyberiadaSMUndoStep* step = undoSteps.takeLast();
+	step->sealed = true;
+	redoSteps.append(step);
+	// the next edit must not be merged into the step below
+	seal();
+	return step;
+}
+
+CyberiadaSMUndoStep* CyberiadaSMHistory::redo()
+{
+	if (redoSteps.isEmpty()) return NULL;
+	CyberiadaSMUndoStep* step = redoSteps.takeLast();
+	undoSteps.append(step);
+	return step;
+}
+
+void CyberiadaSMHistory::recount(CyberiadaSMUndoStep* step)
+{
+	MY_ASSERT(step);
+	bytes -= step->bytes;
+	step->recount();
+	bytes += step->bytes;
+	enforceBudget();
+}
+
+void CyberiadaSMHistory::setBudget(size_t new_bytes)
+{
+	maxBytes = new_bytes;
+	enforceBudget();
+}
+
+void CyberiadaSMHistory::enforceBudget()
+{
+	// the redo steps are the first to go: they are the least likely to be used
+	if (bytes > maxBytes) {
+		clearRedo();
+	}
+	while (bytes > maxBytes && !undoSteps.isEmpty()) {
+		CyberiadaSMUndoStep* step = undoSteps.takeFirst();
+		bytes -= step->bytes;
+		delete step;
+	}
+}
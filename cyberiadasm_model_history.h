@@ -0,0 +1,180 @@
+/* -----------------------------------------------------------------------------
+ * The Cyberiada State Machine Editor
+ * -----------------------------------------------------------------------------
+ *
+ * The State Machine Model undo/redo history
+ *
+ * Copyright (C) 2026 Alexey Fedoseev <aleksey@fedoseev.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses/
+ *
+ * ----------------------------------------------------------------------------- */
+
+#ifndef CYBERIADA_SM_MODEL_HISTORY_HEADER
+#define CYBERIADA_SM_MODEL_HISTORY_HEADER
+
+#include <QList>
+#include <vector>
+#include <cyberiada/cyberiadamlpp.h>
+
+// the default memory budget of the undo/redo history; the editor sets the
+// budget from the preferences (SettingsManager::getUndoBudget(), in MB)
+#define DEFAULT_UNDO_BUDGET (32 * 1024 * 1024)
+// rough memory cost of a detached element kept for undo
+#define UNDO_ELEMENT_ESTIMATED_SIZE 512
+
+enum CyberiadaSMDeltaType {
+	deltaGeometry,
+	deltaTitle,
+	deltaID,
+	deltaActions,
+	deltaInsert,
+	deltaRemove,
+	deltaMove
+};
+
+// the geometry of an element; only the fields relevant to the element type are used
+struct CyberiadaSMGeometry {
+	Cyberiada::Rect                     rect;
+	Cyberiada::Point                    point;
+	Cyberiada::Point                    source_point;
+	Cyberiada::Point                    target_point;
+	Cyberiada::Polyline                 polyline;
+	Cyberiada::ID                       source_id;
+	Cyberiada::ID                       target_id;
+};
+
+// The inverse delta of a single model edit
+class CyberiadaSMDelta {
+public:
+	CyberiadaSMDelta(CyberiadaSMDeltaType t, Cyberiada::Element* e): type(t), element(e) {}
+	virtual ~CyberiadaSMDelta() {}
+
+	virtual size_t                      bytes() const { return sizeof(*this); }
+
+	CyberiadaSMDeltaType                type;
+	Cyberiada::Element*                 element;
+};
+
+class CyberiadaSMGeometryDelta: public CyberiadaSMDelta {
+public:
+	CyberiadaSMGeometryDelta(Cyberiada::Element* e, const CyberiadaSMGeometry& old_g, const CyberiadaSMGeometry& new_g):
+		CyberiadaSMDelta(deltaGeometry, e), old_geometry(old_g), new_geometry(new_g) {}
+
+	size_t                              bytes() const;
+
+	CyberiadaSMGeometry                 old_geometry;
+	CyberiadaSMGeometry                 new_geometry;
+};
+
+// title & ID changes
+class CyberiadaSMTextDelta: public CyberiadaSMDelta {
+public:
+	CyberiadaSMTextDelta(CyberiadaSMDeltaType t, Cyberiada::Element* e, const Cyberiada::String& old_v, const Cyberiada::String& new_v):
+		CyberiadaSMDelta(t, e), old_value(old_v), new_value(new_v) {}
+
+	size_t                              bytes() const;
+
+	Cyberiada::String                   old_value;
+	Cyberiada::String                   new_value;
+};
+
+// state actions or the single transition action
+class CyberiadaSMActionsDelta: public CyberiadaSMDelta {
+public:
+	CyberiadaSMActionsDelta(Cyberiada::Element* e,
+							const std::vector<Cyberiada::Action>& old_a, const std::vector<Cyberiada::Action>& new_a):
+		CyberiadaSMDelta(deltaActions, e), old_actions(old_a), new_actions(new_a) {}
+
+	size_t                              bytes() const;
+
+	std::vector<Cyberiada::Action>      old_actions;
+	std::vector<Cyberiada::Action>      new_actions;
+};
+
+// insertion, removal and reparenting of a subtree; while the subtree is
+// detached from the document the delta owns it and is charged for it
+class CyberiadaSMStructureDelta: public CyberiadaSMDelta {
+public:
+	CyberiadaSMStructureDelta(CyberiadaSMDeltaType t, Cyberiada::Element* e,
+							  Cyberiada::ElementCollection* old_p, int old_r,
+							  Cyberiada::ElementCollection* new_p, int new_r,
+							  size_t subtree_size);
+	~CyberiadaSMStructureDelta();
+
+	size_t                              bytes() const;
+
+	Cyberiada::ElementCollection*       old_parent;
+	int                                 old_row;
+	Cyberiada::ElementCollection*       new_parent;
+	int                                 new_row;
+	size_t                              payload_elements;
+	bool                                owns_payload;
+};
+
+// A group of deltas undone and redone at once
+class CyberiadaSMUndoStep {
+public:
+	CyberiadaSMUndoStep(bool c = false): bytes(0), continuous(c), sealed(false) {}
+	~CyberiadaSMUndoStep();
+
+	void                                add(CyberiadaSMDelta* delta);
+	bool                                isGeometryOnly() const;
+	// absorb the next geometry step of the same continuous edit (the next
+	// drag frame); the deltas of the merged step are taken over
+	bool                                merge(CyberiadaSMUndoStep* next);
+	// recompute the size after the deltas have changed
+	void                                recount();
+
+	QList<CyberiadaSMDelta*>            deltas;
+	size_t                              bytes;
+	// recorded by a continuous edit (a drag), only such steps are merged
+	bool                                continuous;
+	bool                                sealed;
+};
+
+// The undo/redo stacks bounded by the memory budget
+class CyberiadaSMHistory {
+public:
+	CyberiadaSMHistory();
+	~CyberiadaSMHistory();
+
+	void                                clear();
+	void                                push(CyberiadaSMUndoStep* step);
+	void                                seal();
+	// charge the step again after undo/redo has moved its payloads
+	// into or out of the document; the step may be dropped by the budget
+	void                                recount(CyberiadaSMUndoStep* step);
+
+	bool                                canUndo() const { return !undoSteps.isEmpty(); }
+	bool                                canRedo() const { return !redoSteps.isEmpty(); }
+	// the steps stay owned by the history, the caller applies them
+	CyberiadaSMUndoStep*                undo();
+	CyberiadaSMUndoStep*                redo();
+
+	void                                setBudget(size_t bytes);
+	size_t                              budget() const { return maxBytes; }
+	size_t                              usedBytes() const { return bytes; }
+
+private:
+	void                                clearRedo();
+	void                                enforceBudget();
+
+	QList<CyberiadaSMUndoStep*>         undoSteps;
+	QList<CyberiadaSMUndoStep*>         redoSteps;
+	size_t                              bytes;
+	size_t                              maxBytes;
+};
+
+#endif
@@ -42,8 +42,25 @@ CyberiadaSMView::CyberiadaSMView(QWidget* parent):
 //	setSelectionMode(QAbstractItemView::MultiSelection);
 }
 
+void CyberiadaSMView::fetchPath(const QModelIndex& index)
+{
+	// the model exposes the rows lazily: fetch the ancestors top-down
+	// until the index row is exposed at every level
+	QList<QModelIndex> path;
+	for (QModelIndex i = index; i.isValid(); i = i.parent()) {
+		path.prepend(i);
+	}
+	foreach(const QModelIndex& i, path) {
+		QModelIndex parent = i.parent();
+		while (i.row() >= model()->rowCount(parent) && model()->canFetchMore(parent)) {
+			model()->fetchMore(parent);
+		}
+	}
+}
+
 void CyberiadaSMView::select(const QModelIndex& index)
 {
+    fetchPath(index);
     // selectionModel()->select(index, QItemSelectionModel::SelectCurrent | QItemSelectionModel::Rows);
     selectionModel()->select(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
     emit currentIndexActivated(index);
@@ -80,3 +97,39 @@ void CyberiadaSMView::slotModelDataChanged(const QModelIndex& topLeft,
 	}
 }
 
+
+QStringList CyberiadaSMView::expandedElements() const
+{
+	QStringList result;
+	const CyberiadaSMModel* m = static_cast<const CyberiadaSMModel*>(model());
+	if (!m || !m->rootDocument()) return result;
+	// only the fetched rows can be expanded, the walk stops at the collapsed nodes
+	QList<QModelIndex> queue;
+	queue.append(m->documentIndex());
+	while (!queue.isEmpty()) {
+		QModelIndex index = queue.takeFirst();
+		if (!isExpanded(index)) continue;
+		const Cyberiada::Element* element = m->indexToElement(index);
+		MY_ASSERT(element);
+		result.append(QString(element->get_id().c_str()));
+		int rows = m->rowCount(index);
+		for (int row = 0; row < rows; row++) {
+			queue.append(m->index(row, 0, index));
+		}
+	}
+	return result;
+}
+
+void CyberiadaSMView::restoreExpandedElements(const QStringList& ids)
+{
+	CyberiadaSMModel* m = static_cast<CyberiadaSMModel*>(model());
+	if (!m || !m->rootDocument()) return;
+	// the list goes top-down, so the parents are expanded first
+	foreach(const QString& id, ids) {
+		const Cyberiada::Element* element = m->idToElement(id);
+		if (!element) continue;
+		QModelIndex index = m->elementToIndex(element);
+		fetchPath(index);
+		expand(index);
+	}
+}
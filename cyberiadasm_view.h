@@ -25,12 +25,17 @@
 #define CYBERIADA_SM_VIEW
 
 #include <QTreeView>
+#include <QStringList>
 
 class CyberiadaSMView: public QTreeView {
 Q_OBJECT
 public:
 	CyberiadaSMView(QWidget* parent);
 
+	// the IDs of the expanded elements to restore the tree after a reload
+	QStringList expandedElements() const;
+	void restoreExpandedElements(const QStringList& ids);
+
 public slots:
 	void select(const QModelIndex& index);
     void slotModelDataChanged(const QModelIndex &topLeft,
@@ -44,6 +49,9 @@ signals:
 	
 protected:
     void startDrag(Qt::DropActions);
+
+private:
+	void fetchPath(const QModelIndex& index);
 };
 
 #endif
@@ -27,6 +27,7 @@
 #include <iostream>
 #include <QCursor>
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QTextDocument>
 #include <QTextBlockFormat>
 #include <QDebug>
@@ -44,7 +45,6 @@ EditableTextItem::EditableTextItem(QGraphicsItem *parent):
     setFlags(QGraphicsItem::ItemIsSelectable);
     setTextInteractionFlags(Qt::NoTextInteraction);
     setFont(FontManager::instance().getFont());
-    connect(&FontManager::instance(), &FontManager::fontChanged, this, &EditableTextItem::onFontChanged);
 }
 
 EditableTextItem::EditableTextItem(const QString &text, QGraphicsItem *parent):
@@ -53,7 +53,6 @@ EditableTextItem::EditableTextItem(const QString &text, QGraphicsItem *parent):
     setFlags(QGraphicsItem::ItemIsSelectable);
     setTextInteractionFlags(Qt::NoTextInteraction);
     setFont(FontManager::instance().getFont());
-    connect(&FontManager::instance(), &FontManager::fontChanged, this, &EditableTextItem::onFontChanged);
 }
 
 void EditableTextItem::mousePressEvent(QGraphicsSceneMouseEvent *event) {
@@ -120,6 +119,10 @@ void EditableTextItem::hoverEnterEvent(QGraphicsSceneHoverEvent *event) {
 }
 
 void EditableTextItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    // the text is unreadable when zoomed out; the edited one is always shown
+    if (!hasFocus() && option->levelOfDetailFromTransform(painter->worldTransform()) < LOD_TEXT_THRESHOLD) {
+        return;
+    }
     painter->setFont(QFont(font()));
 
     QGraphicsTextItem::paint(painter, option, widget);
@@ -36,6 +36,8 @@ public:
     void setFontStyleChangeable(bool isChangeable);
     void setFontBoldness(bool isBold);
     void setTextMargin(double newTextMargin);
+    // the scene passes the font changes to all text items at once
+    void onFontChanged(const QFont &newFont) ;
 
 protected:
     void focusOutEvent(QFocusEvent *event) override;
@@ -53,9 +55,6 @@ signals:
     void sizeChanged();
     // void editingFinished();
 
-protected slots:
-    void onFontChanged(const QFont &newFont) ;
-
 protected:
     void updateTextWidth();
     bool isEdit;
@@ -31,6 +31,7 @@
 #include "fontmanager.h"
 #include "batch_driver.h"
 #include "cyberiadasm_render.h"
+#include "cyberiadasm_editor_logging.h"
 
 int main(int argc, char *argv[])
 {
@@ -62,6 +63,10 @@ int main(int argc, char *argv[])
 	parser.addOption(saveOption);
 	QCommandLineOption exportOption("export", "Export the scene image in batch mode.", "file");
 	parser.addOption(exportOption);
+	QCommandLineOption cacheOption("cache", "Sidecar document cache in batch mode: off (default), on or refresh.", "mode", "off");
+	parser.addOption(cacheOption);
+	QCommandLineOption repaintOption("repaint", "Print the items repainted after the edit script in batch mode.");
+	parser.addOption(repaintOption);
 	QCommandLineOption noTextOption("no-text", "Hide the text elements in batch mode (font-independent output).");
 	parser.addOption(noTextOption);
 	QCommandLineOption compareOption("compare", "Compare two image files with tolerance and exit.");
@@ -70,11 +75,16 @@ int main(int argc, char *argv[])
 	parser.addOption(epsilonOption);
 	QCommandLineOption maxDiffOption("max-diff", "Comparison allowed differing pixel fraction (default 0).", "f", "0");
 	parser.addOption(maxDiffOption);
+	QCommandLineOption traceOption("trace", "Print the editor debug tracing on stderr (see cyberiadasm_editor_logging.h).");
+	parser.addOption(traceOption);
 	parser.addPositionalArgument("file", "The CyberiadaML document to open in batch mode.", "[file]");
 	parser.process(app);
 
 	bool batch = parser.isSet(batchOption);
 	app.setBatchMode(batch);
+	if (parser.isSet(traceOption)) {
+		enableEditorTracing(true);
+	}
 	if (parser.isSet(noTextOption)) {
 		// font metrics differ across Qt versions even with the pinned font;
 		// the tests hide all text so the output is identical everywhere
@@ -102,9 +112,21 @@ int main(int argc, char *argv[])
 				fprintf(stderr, "batch mode requires exactly one document file\n");
 				return batchUsageError;
 			}
+			QString cache_mode = parser.value(cacheOption);
+			CyberiadaSMCacheMode cache;
+			if (cache_mode == "off") {
+				cache = cacheDisabled;
+			} else if (cache_mode == "on") {
+				cache = cacheEnabled;
+			} else if (cache_mode == "refresh") {
+				cache = cacheRefresh;
+			} else {
+				fprintf(stderr, "unknown cache mode %s\n", qPrintable(cache_mode));
+				return batchUsageError;
+			}
 			return runBatchMode(app, args.first(), parser.isSet(dumpOption),
 								parser.value(scriptOption), parser.value(saveOption),
-								parser.value(exportOption));
+								parser.value(exportOption), cache, parser.isSet(repaintOption));
 		}
 		CyberiadaSMEditorWindow win;
 		win.show();
@@ -25,6 +25,8 @@ void SettingsManager::load() {
     selectionColor = QColor(s.value("display/selectionColor", QColor(Qt::darkGray).name()).toString());
     selectionBorderWidth = s.value("display/selectionBorderWidth", 2).toInt();
     selectionInvertText = s.value("display/selectionInvertText", false).toBool();
+
+    undoBudget = s.value("editing/undoBudget", 32).toInt();
 }
 
 void SettingsManager::loadDefaults()
@@ -41,6 +43,8 @@ void SettingsManager::loadDefaults()
     setSelectionColor(QColor(Qt::red));
     setSelectionBorderWidth(2);
     setSelectionInvertText(false);
+
+    setUndoBudget(32);
 }
 
 void SettingsManager::setShowGrid(bool value)
@@ -120,3 +124,12 @@ void SettingsManager::setSelectionInvertText(bool value)
         emit selectionSettingsChanged();
     }
 }
+
+void SettingsManager::setUndoBudget(int value)
+{
+    if (undoBudget != value) {
+        undoBudget = value;
+        QSettings().setValue("editing/undoBudget", value);
+        emit undoBudgetChanged(value);
+    }
+}
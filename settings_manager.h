@@ -42,6 +42,10 @@ public:
     bool getSelectionInvertText() const { return selectionInvertText; }
     void setSelectionInvertText(bool value);
 
+    // the memory budget of the undo history, in megabytes
+    int getUndoBudget() const { return undoBudget; }
+    void setUndoBudget(int value);
+
 signals:
     void settingsChanged();
 
@@ -53,6 +57,8 @@ signals:
 
     void selectionSettingsChanged();
 
+    void undoBudgetChanged(int);
+
 private:
     SettingsManager();
     SettingsManager(const SettingsManager&) = delete;
@@ -75,6 +81,9 @@ private:
     QColor selectionColor;
     int selectionBorderWidth;
     bool selectionInvertText;
+
+    // editing
+    int undoBudget;
 };
 
 #endif // SETTINGS_MANAGER_H
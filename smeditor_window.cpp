@@ -28,6 +28,7 @@
 #include <QFontDialog>
 #include <QFont>
 #include <QMessageBox>
+#include <QProgressDialog>
 
 #include "smeditor_window.h"
 #include "myassert.h"
@@ -51,10 +52,17 @@ CyberiadaSMEditorWindow::CyberiadaSMEditorWindow(QWidget* parent):
 	sceneView->setScene(scene);
 
     openFileName = QString();
+    loader = NULL;
+    loadProgress = NULL;
     initializeTools();
 
     connect(SMView, SIGNAL(currentIndexActivated(QModelIndex)),
             scene, SLOT(slotElementSelected(QModelIndex)));
+    connect(model, SIGNAL(historyChanged()), this, SLOT(slotHistoryChanged()));
+    connect(model, SIGNAL(modifiedChanged(bool)), this, SLOT(setWindowModified(bool)));
+
+    slotUndoBudgetChanged(SettingsManager::instance().getUndoBudget());
+    connect(&SettingsManager::instance(), SIGNAL(undoBudgetChanged(int)), this, SLOT(slotUndoBudgetChanged(int)));
 }
 
 void CyberiadaSMEditorWindow::slotFileOpen()
@@ -69,25 +77,120 @@ void CyberiadaSMEditorWindow::slotFileOpen()
         actionInspectorMode->setChecked(inspector);
         SettingsManager::instance().setInspectorMode(inspector);
 
-        QString error;
-        if (!openDocument(fileName, &error)) {
-            QMessageBox::critical(this, tr("Load State Machine"), error);
-        }
+        loadDocument(fileName);
     }
 }
 
-bool CyberiadaSMEditorWindow::openDocument(const QString& fileName, QString* error)
+bool CyberiadaSMEditorWindow::openDocument(const QString& fileName, QString* error, CyberiadaSMCacheMode cache)
 {
-    if (!model->loadDocument(fileName)) {
+    QString load_error;
+    Cyberiada::LocalDocument* doc = CyberiadaSMModel::parseDocument(fileName, false, false, load_error, cache);
+    if (!doc) {
         if (error) {
-            *error = model->loadError();
+            *error = load_error;
         }
         return false;
     }
+    setDocument(doc, fileName);
+    return true;
+}
+
+void CyberiadaSMEditorWindow::setDocument(Cyberiada::LocalDocument* doc, const QString& fileName)
+{
+    QStringList expanded = reloadExpandedElements(fileName);
+    // the scene items, their registry entries and the queued syncs point into
+    // the current document: they are released before the model deletes it,
+    // whether the new document has a state machine or not
+    scene->reset();
+    model->setDocument(doc, fileName);
+    documentOpened(fileName, expanded);
+}
+
+void CyberiadaSMEditorWindow::loadDocument(const QString& fileName)
+{
+    slotCancelLoading();
+
+    loader = new CyberiadaSMDocumentLoader(fileName, false, false, cacheEnabled, this);
+    connect(loader, SIGNAL(documentLoaded(QString)), this, SLOT(slotDocumentLoaded(QString)));
+    connect(loader, SIGNAL(loadFailed(QString, QString)), this, SLOT(slotDocumentLoadFailed(QString, QString)));
+    connect(loader, SIGNAL(finished()), loader, SLOT(deleteLater()));
+
+    // the parser does not report its progress, so the dialog is a busy indicator
+    loadProgress = new QProgressDialog(tr("Loading %1...").arg(QFileInfo(fileName).fileName()),
+                                       tr("Cancel"), 0, 0, this);
+    loadProgress->setWindowTitle(tr("Load State Machine"));
+    loadProgress->setWindowModality(Qt::WindowModal);
+    loadProgress->setMinimumDuration(500);
+    connect(loadProgress, SIGNAL(canceled()), this, SLOT(slotCancelLoading()));
+
+    loader->start();
+}
+
+void CyberiadaSMEditorWindow::finishLoading()
+{
+    if (loadProgress) {
+        loadProgress->disconnect(this);
+        loadProgress->deleteLater();
+        loadProgress = NULL;
+    }
+    if (loader) {
+        loader->disconnect(this);
+        // a running loader deletes itself when finished
+        if (!loader->isRunning()) {
+            loader->deleteLater();
+        }
+        loader = NULL;
+    }
+}
+
+void CyberiadaSMEditorWindow::slotDocumentLoaded(const QString& fileName)
+{
+    if (!loader || sender() != loader) return;
+    Cyberiada::LocalDocument* doc = loader->takeDocument();
+    finishLoading();
+    if (doc) {
+        setDocument(doc, fileName);
+    }
+}
+
+void CyberiadaSMEditorWindow::slotDocumentLoadFailed(const QString&, const QString& error)
+{
+    if (!loader || sender() != loader) return;
+    finishLoading();
+    QMessageBox::critical(this, tr("Load State Machine"), error);
+}
+
+void CyberiadaSMEditorWindow::slotCancelLoading()
+{
+    if (!loader) return;
+    // the parser cannot be interrupted: the worker finishes in the background
+    // and drops the parsed document
+    loader->cancel();
+    finishLoading();
+}
+
+QStringList CyberiadaSMEditorWindow::reloadExpandedElements(const QString& fileName) const
+{
+    // the tree state survives reloading the same document only
+    if (model->rootDocument() && !model->filePath().isEmpty() &&
+        QFileInfo(model->filePath()) == QFileInfo(fileName)) {
+        return SMView->expandedElements();
+    }
+    return QStringList();
+}
+
+void CyberiadaSMEditorWindow::documentOpened(const QString& fileName, const QStringList& expanded)
+{
     SMView->setRootIndex(model->rootIndex());
-    SMView->expandToDepth(2);
+    if (expanded.isEmpty()) {
+        // the state machines only: the states are fetched when expanded
+        SMView->expandToDepth(1);
+    } else {
+        SMView->restoreExpandedElements(expanded);
+    }
     QModelIndex sm = model->firstSMIndex();
     if (sm.isValid()) {
+        // a new document starts with its first state machine
         scene->loadScene();
         SMView->select(sm);
     }
@@ -96,19 +199,19 @@ bool CyberiadaSMEditorWindow::openDocument(const QString& fileName, QString* err
     openFileName = fileInfo.fileName();
 
     if (!openFileName.isEmpty()) {
+        // [*] is replaced with the unsaved changes mark
         if (SettingsManager::instance().getInspectorMode()) {
-            setWindowTitle(openFileName + " (inspector mode)");
+            setWindowTitle(openFileName + "[*] (inspector mode)");
         } else {
-            setWindowTitle(openFileName);
+            setWindowTitle(openFileName + "[*]");
         }
+        setWindowModified(model->isModified());
     }
-    return true;
 }
 
 void CyberiadaSMEditorWindow::slotFileSave()
 {
-    if (model->rootDocument() && !model->rootDocument()->get_file_path().empty()) {
-        qDebug() << model->rootDocument()->get_file_path().empty();
+    if (model->rootDocument() && !model->filePath().isEmpty()) {
         model->saveDocument();
     } else {
         slotFileSaveAs();
@@ -137,11 +240,13 @@ void CyberiadaSMEditorWindow::slotFileSaveAs()
     openFileName = fileInfo.fileName();
 
     if (!openFileName.isEmpty()) {
+        // [*] is replaced with the unsaved changes mark
         if (SettingsManager::instance().getInspectorMode()) {
-            setWindowTitle(openFileName + " (inspector mode)");
+            setWindowTitle(openFileName + "[*] (inspector mode)");
         } else {
-            setWindowTitle(openFileName);
+            setWindowTitle(openFileName + "[*]");
         }
+        setWindowModified(model->isModified());
     }
 }
 
@@ -220,7 +325,7 @@ void CyberiadaSMEditorWindow::slotToolSelected(QAction *action)
 }
 
 void CyberiadaSMEditorWindow::slotFitContent() {
-    sceneView->fitInView(scene->itemsBoundingRect(), Qt::KeepAspectRatio);
+    sceneView->fitInView(scene->contentBoundingRect(), Qt::KeepAspectRatio);
 }
 
 void CyberiadaSMEditorWindow::slotPreferences()
@@ -297,6 +402,28 @@ void CyberiadaSMEditorWindow::slotDeleteElement()
     }
 }
 
+void CyberiadaSMEditorWindow::slotUndo()
+{
+    // the scene follows the reverted changes itself
+    model->undo();
+}
+
+void CyberiadaSMEditorWindow::slotRedo()
+{
+    model->redo();
+}
+
+void CyberiadaSMEditorWindow::slotHistoryChanged()
+{
+    actionUndo->setEnabled(model->canUndo());
+    actionRedo->setEnabled(model->canRedo());
+}
+
+void CyberiadaSMEditorWindow::slotUndoBudgetChanged(int megabytes)
+{
+    model->setUndoBudget(size_t(megabytes) * 1024 * 1024);
+}
+
 void CyberiadaSMEditorWindow::slotInspectorModeTriggered(bool on)
 {
     if (on == SettingsManager::instance().getInspectorMode()) { return; }
@@ -28,19 +28,30 @@
 #include "ui_smeditor_window.h"
 #include "cyberiadasm_model.h"
 #include "cyberiadasm_editor_scene.h"
+#include "cyberiadasm_document_loader.h"
+
+class QProgressDialog;
 
 class CyberiadaSMEditorWindow: public QMainWindow, public Ui_SMEditorWindow {
 Q_OBJECT
 public:
     CyberiadaSMEditorWindow(QWidget* parent = 0);
 
-    bool                    openDocument(const QString& fileName, QString* error = NULL);
+    // synchronous loading (batch mode)
+    bool                    openDocument(const QString& fileName, QString* error = NULL,
+                                         CyberiadaSMCacheMode cache = cacheDisabled);
+    // background loading with the progress dialog
+    void                    loadDocument(const QString& fileName);
 
     CyberiadaSMModel*       getModel() { return model; }
     CyberiadaSMEditorScene* getScene() { return scene; }
 
 private:
     void                    initializeTools();
+    QStringList             reloadExpandedElements(const QString& fileName) const;
+    void                    setDocument(Cyberiada::LocalDocument* doc, const QString& fileName);
+    void                    documentOpened(const QString& fileName, const QStringList& expanded = QStringList());
+    void                    finishLoading();
 
 public slots:
 	void                    slotFileOpen();
@@ -68,6 +79,15 @@ public slots:
 
     void                    slotDeleteElement();
 
+    void                    slotUndo();
+    void                    slotRedo();
+    void                    slotHistoryChanged();
+    void                    slotUndoBudgetChanged(int megabytes);
+
+    void                    slotDocumentLoaded(const QString& fileName);
+    void                    slotDocumentLoadFailed(const QString& fileName, const QString& error);
+    void                    slotCancelLoading();
+
 private:
 	CyberiadaSMModel*       model;
 	CyberiadaSMEditorScene* scene;
@@ -75,6 +95,8 @@ private:
     ToolType currentTool = ToolType::Select;
 
     QString openFileName;
+    CyberiadaSMDocumentLoader* loader;
+    QProgressDialog* loadProgress;
 
     QMap<ToolType, QAction*> toolActMap;
 };
@@ -0,0 +1,46 @@
+# Open a copy of INPUT twice in batch mode: first parsing the XML and writing
+# the sidecar cache (--cache refresh), then rebuilding the document from that
+# cache (--cache on); both runs dump and save the document into WORKDIR, and
+# the dumps and the saved documents must be identical
+get_filename_component(_name ${INPUT} NAME)
+file(REMOVE_RECURSE ${WORKDIR})
+file(MAKE_DIRECTORY ${WORKDIR})
+# the cache is written next to the document, never next to the test diagrams
+file(COPY ${INPUT} DESTINATION ${WORKDIR})
+set(_doc ${_name})
+
+foreach(_mode refresh on)
+  execute_process(COMMAND ${BATCH_BIN} --batch --no-text ${_doc} --cache ${_mode}
+      --dump --save cache-${_mode}.graphml
+    WORKING_DIRECTORY ${WORKDIR}
+    OUTPUT_FILE ${WORKDIR}/cache-${_mode}.out
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "--cache ${_mode}: exit code ${result}, expected 0")
+  endif()
+  if(NOT EXISTS ${WORKDIR}/${_doc}.cybcache)
+    message(FATAL_ERROR "--cache ${_mode}: no cache written for ${_doc}")
+  endif()
+  file(READ ${WORKDIR}/cache-${_mode}.out _dump_${_mode})
+endforeach()
+
+# a restored document has no file bound: the file fields ending the document
+# line differ, and they are the proof the second run used the cache
+if(_dump_refresh STREQUAL _dump_on)
+  message(FATAL_ERROR "--cache on did not restore ${_doc} from the cache")
+endif()
+foreach(_mode refresh on)
+  string(REGEX REPLACE "}, file: [^\n]*\n" "}\n" _dump_${_mode} "${_dump_${_mode}}")
+endforeach()
+if(NOT _dump_refresh STREQUAL _dump_on)
+  execute_process(COMMAND diff -u cache-refresh.out cache-on.out WORKING_DIRECTORY ${WORKDIR})
+  message(FATAL_ERROR "the dump of the cached ${_doc} differs from the parsed one")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files cache-refresh.graphml cache-on.graphml
+  WORKING_DIRECTORY ${WORKDIR}
+  RESULT_VARIABLE diff)
+if(NOT diff EQUAL 0)
+  execute_process(COMMAND diff -u cache-refresh.graphml cache-on.graphml WORKING_DIRECTORY ${WORKDIR})
+  message(FATAL_ERROR "the cached ${_doc} is saved differently from the parsed one")
+endif()
@@ -0,0 +1,29 @@
+# Run the edit SCRIPT on INPUT in batch mode with --repaint (written to
+# OUTPUT) and check the items fully repainted after the script: every id of
+# REPAINTED must be listed, no id of KEPT may be
+set(_args --batch --no-text --repaint ${INPUT} --script ${SCRIPT})
+execute_process(COMMAND ${BATCH_BIN} ${_args}
+  WORKING_DIRECTORY ${WORKDIR}
+  OUTPUT_FILE ${OUTPUT}
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "exit code ${result}, expected 0")
+endif()
+file(READ ${OUTPUT} _out)
+string(FIND "${_out}" "== repaint\n" _pos)
+if(_pos EQUAL -1)
+  message(FATAL_ERROR "no repaint section in ${OUTPUT}")
+endif()
+string(SUBSTRING "${_out}" ${_pos} -1 _repaint)
+foreach(_id ${REPAINTED})
+  string(FIND "${_repaint}" "{id: '${_id}'}" _found)
+  if(_found EQUAL -1)
+    message(FATAL_ERROR "${_id} is not repainted after the script:\n${_repaint}")
+  endif()
+endforeach()
+foreach(_id ${KEPT})
+  string(FIND "${_repaint}" "{id: '${_id}'}" _found)
+  if(NOT _found EQUAL -1)
+    message(FATAL_ERROR "${_id} is repainted after the script:\n${_repaint}")
+  endif()
+endforeach()